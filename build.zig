@@ -41,6 +41,14 @@ pub fn build(b: *std.Build) void {
         .target = target,
     });
 
+    const options = b.addOptions();
+    options.addOption(
+        bool,
+        "trace",
+        b.option(bool, "trace", "Record trace events for --trace") orelse false,
+    );
+    mod.addOptions("build_options", options);
+
     // Here we define an executable. An executable needs to have a root module
     // which needs to expose a `main` function. While we could add a main function
     // to the module defined above, it's sometimes preferable to split business
@@ -142,6 +150,23 @@ pub fn build(b: *std.Build) void {
     test_step.dependOn(&run_mod_tests.step);
     test_step.dependOn(&run_exe_tests.step);
 
+    // Tracing is compiled out unless -Dtrace is given, so the module tests
+    // run a second time with it enabled to cover the recording code.
+    const trace_options = b.addOptions();
+    trace_options.addOption(bool, "trace", true);
+    const trace_mod = b.createModule(.{
+        .root_source_file = b.path("src/root.zig"),
+        .target = target,
+    });
+    trace_mod.addOptions("build_options", trace_options);
+    const trace_tests = b.addTest(.{
+        .root_module = trace_mod,
+    });
+    const run_trace_tests = b.addRunArtifact(trace_tests);
+    const trace_test_step = b.step("test-trace", "Run tests with tracing enabled");
+    trace_test_step.dependOn(&run_trace_tests.step);
+    test_step.dependOn(&run_trace_tests.step);
+
     // Just like flags, top level steps are also listed in the `--help` menu.
     //
     // The Zig build system is entirely implemented in userland, which means
@@ -0,0 +1,486 @@
+const std = @import("std");
+const lexer = @import("../lexer/lexer.zig");
+const trace = @import("../trace/trace.zig");
+const memory = @import("../memory/memory.zig");
+pub const symbols = @import("symbols.zig");
+pub const trigrams = @import("trigrams.zig");
+
+pub const symbols_file_name = ".helena-symbols";
+pub const trigrams_file_name = ".helena-trigrams";
+pub const source_extension = ".helena";
+
+const empty_bytes: [0]u8 align(std.heap.page_size_min) = .{};
+
+pub const Mapping = struct {
+    bytes: []align(std.heap.page_size_min) const u8,
+
+    pub const empty = Mapping{ .bytes = &empty_bytes };
+
+    pub const Access = enum {
+        normal,
+        sequential,
+        random,
+    };
+
+    pub fn open(io: std.Io, dir: std.Io.Dir, path: []const u8) !Mapping {
+        const file = try dir.openFile(io, path, .{});
+        defer file.close(io);
+        const size = (try file.stat(io)).size;
+        if (size == 0)
+            return empty;
+        return .{
+            .bytes = try std.posix.mmap(
+                null,
+                size,
+                std.posix.PROT.READ,
+                .{ .TYPE = .PRIVATE },
+                file.handle,
+                0,
+            ),
+        };
+    }
+
+    pub fn advise(self: Mapping, access: Access) void {
+        if (self.bytes.len == 0)
+            return;
+        std.posix.madvise(
+            @constCast(self.bytes.ptr),
+            self.bytes.len,
+            switch (access) {
+                .normal => std.posix.MADV.NORMAL,
+                .sequential => std.posix.MADV.SEQUENTIAL,
+                .random => std.posix.MADV.RANDOM,
+            },
+        ) catch {};
+    }
+
+    pub fn close(self: Mapping) void {
+        if (self.bytes.len > 0)
+            std.posix.munmap(self.bytes);
+    }
+};
+
+pub const Span = extern struct {
+    offset: u32,
+    len: u32,
+};
+pub const FileEntry = extern struct {
+    path: Span,
+    modified: i64,
+};
+
+pub fn FileTable(comptime Item: type) type {
+    return struct {
+        entries: std.StringArrayHashMapUnmanaged(File),
+
+        const Self = @This();
+
+        pub const File = struct {
+            modified: i64,
+            items: std.ArrayList(Item),
+        };
+
+        pub const empty = Self{ .entries = .empty };
+
+        pub fn deinit(self: *Self, allocator: std.mem.Allocator) void {
+            for (self.entries.keys(), self.entries.values()) |path, *file| {
+                allocator.free(path);
+                file.items.deinit(allocator);
+            }
+            self.entries.deinit(allocator);
+        }
+
+        pub fn count(self: *const Self) usize {
+            return self.entries.count();
+        }
+
+        pub fn modifiedAt(self: *const Self, path: []const u8) ?i64 {
+            return if (self.entries.get(path)) |file| file.modified else null;
+        }
+
+        pub fn itemsOf(
+            self: *Self,
+            allocator: std.mem.Allocator,
+            path: []const u8,
+            modified_at: i64,
+        ) !*std.ArrayList(Item) {
+            const entry = try self.entries.getOrPut(allocator, path);
+            if (!entry.found_existing) {
+                entry.key_ptr.* = allocator.dupe(u8, path) catch |err| {
+                    self.entries.swapRemoveAt(entry.index);
+                    return err;
+                };
+                entry.value_ptr.* = .{ .modified = modified_at, .items = .empty };
+            }
+            entry.value_ptr.modified = modified_at;
+            return &entry.value_ptr.items;
+        }
+
+        pub fn retain(
+            self: *Self,
+            allocator: std.mem.Allocator,
+            paths: []const []const u8,
+        ) void {
+            var index: usize = 0;
+            while (index < self.entries.count()) {
+                const path = self.entries.keys()[index];
+                if (std.sort.binarySearch([]const u8, paths, path, orderPaths) != null) {
+                    index += 1;
+                    continue;
+                }
+                var file = self.entries.values()[index];
+                file.items.deinit(allocator);
+                self.entries.swapRemoveAt(index);
+                allocator.free(path);
+            }
+        }
+
+        pub fn fileEntries(
+            self: *const Self,
+            allocator: std.mem.Allocator,
+            strings_len: *usize,
+        ) ![]FileEntry {
+            const files = try allocator.alloc(FileEntry, self.entries.count());
+            for (self.entries.keys(), self.entries.values(), files) |path, file, *entry| {
+                entry.* = .{
+                    .path = .{ .offset = @intCast(strings_len.*), .len = @intCast(path.len) },
+                    .modified = file.modified,
+                };
+                strings_len.* += path.len;
+            }
+            return files;
+        }
+
+        pub fn writePaths(self: *const Self, writer: *std.Io.Writer) !void {
+            for (self.entries.keys()) |path|
+                try writer.writeAll(path);
+        }
+    };
+}
+
+pub fn section(
+    comptime T: type,
+    bytes: []align(@alignOf(FileEntry)) const u8,
+    offset: *usize,
+    count: u32,
+) ![]const T {
+    const len = @as(usize, count) * @sizeOf(T);
+    if (bytes.len - offset.* < len)
+        return error.InvalidIndex;
+    const slice: []const T = @alignCast(std.mem.bytesAsSlice(
+        T,
+        bytes[offset.*..][0..len],
+    ));
+    offset.* += len;
+    return slice;
+}
+
+pub fn fits(span: Span, len: usize) bool {
+    return span.offset <= len and len - span.offset >= span.len;
+}
+
+pub fn findSources(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    root: std.Io.Dir,
+) ![][]const u8 {
+    var paths = std.ArrayList([]const u8).empty;
+    errdefer {
+        for (paths.items) |path|
+            allocator.free(path);
+        paths.deinit(allocator);
+    }
+    var walker = try root.walk(allocator);
+    defer walker.deinit();
+    while (try walker.next(io)) |entry| {
+        if (entry.kind != .file or
+            !std.mem.endsWith(u8, entry.basename, source_extension))
+            continue;
+        const path = try allocator.dupe(u8, entry.path);
+        errdefer allocator.free(path);
+        try paths.append(allocator, path);
+    }
+    std.sort.pdq([]const u8, paths.items, {}, struct {
+        fn lessThan(_: void, lhs: []const u8, rhs: []const u8) bool {
+            return std.mem.lessThan(u8, lhs, rhs);
+        }
+    }.lessThan);
+    return paths.toOwnedSlice(allocator);
+}
+
+pub fn freeSources(allocator: std.mem.Allocator, paths: []const []const u8) void {
+    for (paths) |path|
+        allocator.free(path);
+    allocator.free(paths);
+}
+
+pub fn modified(io: std.Io, dir: std.Io.Dir, path: []const u8) !i64 {
+    const stat = try dir.statFile(io, path, .{});
+    return @intCast(stat.mtime.nanoseconds);
+}
+
+fn Lexed(comptime Item: type) type {
+    return struct {
+        path: []const u8,
+        modified: i64,
+        strings: []const u8,
+        items: []const Item,
+        failure: ?anyerror,
+    };
+}
+
+fn Job(comptime module: type, comptime Item: type) type {
+    return struct {
+        allocator: std.mem.Allocator,
+        io: std.Io,
+        root: std.Io.Dir,
+        files: []Lexed(Item),
+        next: std.atomic.Value(usize),
+
+        const Self = @This();
+
+        fn run(self: *Self) void {
+            const phase = memory.enter(.indexing);
+            defer phase.exit();
+            while (true) {
+                const index = self.next.fetchAdd(1, .monotonic);
+                if (index >= self.files.len)
+                    return;
+                const file = &self.files[index];
+                self.lex(file) catch |err| {
+                    file.failure = err;
+                };
+            }
+        }
+
+        fn lex(self: *Self, file: *Lexed(Item)) !void {
+            const span = trace.beginDetail("lex file", file.path);
+            defer span.end();
+            const file_scope = memory.enterFile(file.path);
+            defer file_scope.exit();
+            const source = try Mapping.open(self.io, self.root, file.path);
+            defer source.close();
+            source.advise(.sequential);
+            const result = try lexer.tokenize(self.allocator, source.bytes);
+            defer result.destroy(self.allocator);
+            const items = try module.collect(self.allocator, result.locations);
+            errdefer self.allocator.free(items);
+            if (@hasDecl(module, "detach"))
+                file.strings = try module.detach(self.allocator, items);
+            file.items = items;
+        }
+    };
+}
+
+pub const Update = struct {
+    file_count: usize,
+    lexed_count: usize,
+};
+
+pub fn updateSymbols(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    root: std.Io.Dir,
+) !Update {
+    return update(
+        symbols,
+        symbols.Occurrence,
+        symbols_file_name,
+        allocator,
+        io,
+        root,
+    );
+}
+
+pub fn updateTrigrams(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    root: std.Io.Dir,
+) !Update {
+    return update(trigrams, u32, trigrams_file_name, allocator, io, root);
+}
+
+fn update(
+    comptime module: type,
+    comptime Item: type,
+    comptime file_name: []const u8,
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    root: std.Io.Dir,
+) !Update {
+    const span = trace.beginDetail("update index", file_name);
+    defer span.end();
+    const phase = memory.enter(.indexing);
+    defer phase.exit();
+    var builder = module.Builder.init(allocator);
+    defer builder.deinit();
+    var is_loaded = false;
+    if (Mapping.open(io, root, file_name)) |mapping| {
+        defer mapping.close();
+        if (module.View.init(mapping.bytes)) |view| {
+            if (builder.load(view)) |_| {
+                is_loaded = true;
+            } else |err| switch (err) {
+                error.InvalidIndex => {
+                    builder.deinit();
+                    builder = module.Builder.init(allocator);
+                },
+                else => return err,
+            }
+        } else |_| {}
+    } else |err| switch (err) {
+        error.FileNotFound => {},
+        else => return err,
+    }
+    const paths = try findSources(allocator, io, root);
+    defer freeSources(allocator, paths);
+    var present = std.ArrayList([]const u8).empty;
+    defer present.deinit(allocator);
+    var stale = std.ArrayList(Lexed(Item)).empty;
+    defer {
+        for (stale.items) |file| {
+            allocator.free(file.strings);
+            allocator.free(file.items);
+        }
+        stale.deinit(allocator);
+    }
+    for (paths) |path| {
+        const modified_at = modified(io, root, path) catch |err| switch (err) {
+            error.FileNotFound => continue,
+            else => return err,
+        };
+        try present.append(allocator, path);
+        const indexed_at = builder.modified(path);
+        if (indexed_at == null or indexed_at.? != modified_at)
+            try stale.append(allocator, .{
+                .path = path,
+                .modified = modified_at,
+                .strings = &.{},
+                .items = &.{},
+                .failure = null,
+            });
+    }
+    var job = Job(module, Item){
+        .allocator = allocator,
+        .io = io,
+        .root = root,
+        .files = stale.items,
+        .next = .init(0),
+    };
+    const thread_count = @min(
+        stale.items.len,
+        std.Thread.getCpuCount() catch 1,
+    );
+    const threads = try allocator.alloc(std.Thread, thread_count -| 1);
+    defer allocator.free(threads);
+    var spawned: usize = 0;
+    for (threads) |*thread| {
+        thread.* = std.Thread.spawn(.{}, @TypeOf(job).run, .{&job}) catch break;
+        spawned += 1;
+    }
+    job.run();
+    for (threads[0..spawned]) |thread|
+        thread.join();
+    for (stale.items) |file| {
+        const err = file.failure orelse continue;
+        if (err != error.FileNotFound)
+            return err;
+        const index = std.sort.binarySearch(
+            []const u8,
+            present.items,
+            file.path,
+            orderPaths,
+        ).?;
+        _ = present.orderedRemove(index);
+    }
+    const loaded_count = builder.files.count();
+    builder.retain(present.items);
+    const is_removed = builder.files.count() != loaded_count;
+    var lexed_count: usize = 0;
+    for (stale.items) |file| {
+        if (file.failure != null)
+            continue;
+        try builder.update(file.path, file.modified, file.items);
+        lexed_count += 1;
+    }
+    if (!is_loaded or is_removed or lexed_count > 0) {
+        const write_span = trace.begin("write index");
+        defer write_span.end();
+        const temporary_name = file_name ++ ".tmp";
+        {
+            const file = try root.createFile(io, temporary_name, .{});
+            defer file.close(io);
+            errdefer root.deleteFile(io, temporary_name) catch {};
+            var buffer: [64 * 1024]u8 = undefined;
+            var writer = file.writer(io, &buffer);
+            try builder.write(&writer.interface);
+            try writer.interface.flush();
+        }
+        root.rename(temporary_name, root, file_name, io) catch |err| {
+            root.deleteFile(io, temporary_name) catch {};
+            return err;
+        };
+    }
+    return .{ .file_count = present.items.len, .lexed_count = lexed_count };
+}
+
+fn orderPaths(path: []const u8, other: []const u8) std.math.Order {
+    return std.mem.order(u8, path, other);
+}
+
+pub fn search(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    root: std.Io.Dir,
+    query: []const u8,
+    include_literals: bool,
+    writer: *std.Io.Writer,
+) !void {
+    const span = trace.begin("search");
+    defer span.end();
+    const mapping = try Mapping.open(io, root, trigrams_file_name);
+    defer mapping.close();
+    const view = try trigrams.View.init(mapping.bytes);
+    const candidates = try view.candidates(allocator, query, include_literals);
+    defer allocator.free(candidates);
+    for (candidates) |file| {
+        const path = view.path(file);
+        const file_span = trace.beginDetail("verify file", path);
+        defer file_span.end();
+        const source_mapping = Mapping.open(io, root, path) catch |err| switch (err) {
+            error.FileNotFound => continue,
+            else => return err,
+        };
+        defer source_mapping.close();
+        source_mapping.advise(.sequential);
+        const source = source_mapping.bytes;
+        const result = try lexer.tokenize(allocator, source);
+        defer result.destroy(allocator);
+        const matches = try trigrams.find(
+            allocator,
+            source,
+            result.locations,
+            query,
+            include_literals,
+        );
+        defer allocator.free(matches);
+        var lines = std.mem.splitScalar(u8, source, '\n');
+        var line = lines.next().?;
+        var row: u32 = 0;
+        for (matches) |match| {
+            while (row < match.row) : (row += 1)
+                line = lines.next() orelse "";
+            try writer.print("{s}:{d}:{d}: {s}\n", .{
+                path,
+                match.row + 1,
+                match.column + 1,
+                line,
+            });
+        }
+    }
+}
+
+test {
+    _ = symbols;
+    _ = trigrams;
+}
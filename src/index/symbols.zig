@@ -0,0 +1,605 @@
+const std = @import("std");
+const testing = std.testing;
+const lexer = @import("../lexer/lexer.zig");
+const shared = @import("index.zig");
+
+pub const Kind = enum {
+    declaration,
+    reference,
+};
+pub const Occurrence = struct {
+    name: []const u8,
+    kind: Kind,
+    row: u32,
+    column: u32,
+};
+pub const Record = extern struct {
+    symbol: u32,
+    file: u32,
+    row: u32,
+    column: u32,
+};
+
+const Span = shared.Span;
+const FileEntry = shared.FileEntry;
+const Header = extern struct {
+    magic: [4]u8,
+    version: u32,
+    file_count: u32,
+    name_count: u32,
+    declaration_count: u32,
+    reference_count: u32,
+    strings_len: u32,
+    padding: u32 = 0,
+};
+
+const magic = "HSYM".*;
+const version = 1;
+const keywords = std.StaticStringMap(void).initComptime(.{
+    .{"as"},
+    .{"else"},
+    .{"for"},
+    .{"if"},
+    .{"in"},
+    .{"nil"},
+    .{"struct"},
+    .{"while"},
+});
+const markers = "?&";
+
+pub fn collect(
+    allocator: std.mem.Allocator,
+    locations: []const lexer.Location,
+) ![]Occurrence {
+    var occurrences = std.ArrayList(Occurrence).empty;
+    errdefer occurrences.deinit(allocator);
+    var pending: enum { none, declaration, link, structure } = .none;
+    var depth: usize = 0;
+    var struct_depth: ?usize = null;
+    var is_line_start = true;
+    var index: usize = 0;
+    while (index < locations.len) : (index += 1) {
+        const location = locations[index];
+        switch (location.token) {
+            .whitespace, .tab => continue,
+            .newline => {
+                is_line_start = true;
+                continue;
+            },
+            .let => pending = .declaration,
+            .link => pending = .link,
+            .left_curly_brace => {
+                depth += 1;
+                if (pending == .structure)
+                    struct_depth = depth;
+                pending = .none;
+            },
+            .right_curly_brace => {
+                if (struct_depth != null and struct_depth.? == depth)
+                    struct_depth = null;
+                depth -|= 1;
+                pending = .none;
+            },
+            .asterisk => if (pending != .declaration) {
+                pending = .none;
+            },
+            .at, .identifier => if (pending == .link) {
+                pending = .none;
+            } else if (nameAt(locations, index)) |name| {
+                var text = name.text;
+                index = name.last;
+                const is_field = is_line_start and
+                    struct_depth != null and
+                    struct_depth.? == depth and
+                    index + 1 < locations.len and
+                    locations[index + 1].token == .colon;
+                if (pending == .declaration)
+                    while (index + 2 < locations.len and
+                        locations[index + 1].token == .dot)
+                    {
+                        const member = nameAt(locations, index + 2) orelse break;
+                        if (locations[index + 2].token != .identifier or
+                            member.text.len != locations[index + 2].token.identifier.len)
+                            break;
+                        text = text.ptr[0 .. @intFromPtr(member.text.ptr) +
+                            member.text.len - @intFromPtr(text.ptr)];
+                        index = member.last;
+                    };
+                const kind: Kind = if (pending == .declaration or is_field)
+                    .declaration
+                else
+                    .reference;
+                if (kind == .declaration or !keywords.has(text))
+                    try occurrences.append(allocator, .{
+                        .name = text,
+                        .kind = kind,
+                        .row = location.row,
+                        .column = name.column,
+                    });
+                pending = if (std.mem.eql(u8, text, "struct"))
+                    .structure
+                else
+                    .none;
+            } else if (pending != .declaration) {
+                pending = .none;
+            },
+            else => pending = .none,
+        }
+        is_line_start = false;
+    }
+    return occurrences.toOwnedSlice(allocator);
+}
+
+pub fn detach(allocator: std.mem.Allocator, occurrences: []Occurrence) ![]u8 {
+    var len: usize = 0;
+    for (occurrences) |occurrence|
+        len += occurrence.name.len;
+    const strings = try allocator.alloc(u8, len);
+    var offset: usize = 0;
+    for (occurrences) |*occurrence| {
+        const name = strings[offset..][0..occurrence.name.len];
+        @memcpy(name, occurrence.name);
+        occurrence.name = name;
+        offset += name.len;
+    }
+    return strings;
+}
+
+const Name = struct {
+    text: []const u8,
+    column: u32,
+    last: usize,
+};
+
+fn nameAt(locations: []const lexer.Location, index: usize) ?Name {
+    const location = locations[index];
+    switch (location.token) {
+        .at => {
+            if (index + 1 == locations.len or
+                locations[index + 1].token != .identifier)
+                return null;
+            const identifier = locations[index + 1].token.identifier;
+            const text = std.mem.trimEnd(u8, identifier, markers);
+            if (!isName(text))
+                return null;
+            return .{
+                .text = (text.ptr - 1)[0 .. text.len + 1],
+                .column = location.column,
+                .last = index + 1,
+            };
+        },
+        .identifier => |identifier| {
+            const start = std.mem.indexOfNone(u8, identifier, markers) orelse
+                return null;
+            const text = std.mem.trimEnd(u8, identifier[start..], markers);
+            if (!isName(text))
+                return null;
+            return .{
+                .text = text,
+                .column = location.column + @as(u32, @intCast(start)),
+                .last = index,
+            };
+        },
+        else => return null,
+    }
+}
+
+fn isName(text: []const u8) bool {
+    if (text.len == 0 or std.mem.eql(u8, text, "_"))
+        return false;
+    for (text) |character|
+        if (!std.ascii.isAlphanumeric(character) and character != '_')
+            return false;
+    return true;
+}
+
+pub const Builder = struct {
+    allocator: std.mem.Allocator,
+    names: std.StringArrayHashMapUnmanaged(void),
+    files: shared.FileTable(Interned),
+
+    const Interned = struct {
+        name: u32,
+        kind: Kind,
+        row: u32,
+        column: u32,
+    };
+
+    pub fn init(allocator: std.mem.Allocator) Builder {
+        return .{ .allocator = allocator, .names = .empty, .files = .empty };
+    }
+
+    pub fn deinit(self: *Builder) void {
+        for (self.names.keys()) |name|
+            self.allocator.free(name);
+        self.names.deinit(self.allocator);
+        self.files.deinit(self.allocator);
+    }
+
+    pub fn load(self: *Builder, view: View) !void {
+        for (view.files) |file|
+            (try self.files.itemsOf(
+                self.allocator,
+                try view.string(file.path),
+                file.modified,
+            )).clearRetainingCapacity();
+        for ([_]Kind{ .declaration, .reference }) |kind|
+            for (view.records(kind)) |record| {
+                if (record.symbol >= view.names.len)
+                    return error.InvalidIndex;
+                const path = try view.path(record.file);
+                try self.files.entries.getPtr(path).?.items.append(
+                    self.allocator,
+                    .{
+                        .name = try self.intern(try view.string(view.names[record.symbol])),
+                        .kind = kind,
+                        .row = record.row,
+                        .column = record.column,
+                    },
+                );
+            };
+    }
+
+    pub fn modified(self: *const Builder, path: []const u8) ?i64 {
+        return self.files.modifiedAt(path);
+    }
+
+    pub fn update(
+        self: *Builder,
+        path: []const u8,
+        modified_at: i64,
+        occurrences: []const Occurrence,
+    ) !void {
+        const list = try self.files.itemsOf(self.allocator, path, modified_at);
+        list.clearRetainingCapacity();
+        try list.ensureTotalCapacity(self.allocator, occurrences.len);
+        for (occurrences) |occurrence|
+            list.appendAssumeCapacity(.{
+                .name = try self.intern(occurrence.name),
+                .kind = occurrence.kind,
+                .row = occurrence.row,
+                .column = occurrence.column,
+            });
+    }
+
+    pub fn retain(self: *Builder, paths: []const []const u8) void {
+        self.files.retain(self.allocator, paths);
+    }
+
+    pub fn write(self: *const Builder, writer: *std.Io.Writer) !void {
+        const allocator = self.allocator;
+        const symbols = try allocator.alloc(u32, self.names.count());
+        defer allocator.free(symbols);
+        @memset(symbols, std.math.maxInt(u32));
+        var declaration_count: usize = 0;
+        var reference_count: usize = 0;
+        for (self.files.entries.values()) |file|
+            for (file.items.items) |occurrence| {
+                symbols[occurrence.name] = 0;
+                switch (occurrence.kind) {
+                    .declaration => declaration_count += 1,
+                    .reference => reference_count += 1,
+                }
+            };
+        var sorted_names = std.ArrayList(u32).empty;
+        defer sorted_names.deinit(allocator);
+        for (symbols, 0..) |symbol, name|
+            if (symbol == 0)
+                try sorted_names.append(allocator, @intCast(name));
+        std.sort.pdq(u32, sorted_names.items, self.names.keys(), struct {
+            fn lessThan(names: []const []const u8, lhs: u32, rhs: u32) bool {
+                return std.mem.lessThan(u8, names[lhs], names[rhs]);
+            }
+        }.lessThan);
+        for (sorted_names.items, 0..) |name, symbol|
+            symbols[name] = @intCast(symbol);
+        const declarations = try allocator.alloc(Record, declaration_count);
+        defer allocator.free(declarations);
+        const references = try allocator.alloc(Record, reference_count);
+        defer allocator.free(references);
+        declaration_count = 0;
+        reference_count = 0;
+        for (self.files.entries.values(), 0..) |file, file_index|
+            for (file.items.items) |occurrence| {
+                const record = Record{
+                    .symbol = symbols[occurrence.name],
+                    .file = @intCast(file_index),
+                    .row = occurrence.row,
+                    .column = occurrence.column,
+                };
+                switch (occurrence.kind) {
+                    .declaration => {
+                        declarations[declaration_count] = record;
+                        declaration_count += 1;
+                    },
+                    .reference => {
+                        references[reference_count] = record;
+                        reference_count += 1;
+                    },
+                }
+            };
+        std.sort.pdq(Record, declarations, {}, recordLessThan);
+        std.sort.pdq(Record, references, {}, recordLessThan);
+        var strings_len: usize = 0;
+        const files = try self.files.fileEntries(allocator, &strings_len);
+        defer allocator.free(files);
+        const names = try allocator.alloc(Span, sorted_names.items.len);
+        defer allocator.free(names);
+        for (sorted_names.items, names) |name, *span| {
+            const text = self.names.keys()[name];
+            span.* = .{ .offset = @intCast(strings_len), .len = @intCast(text.len) };
+            strings_len += text.len;
+        }
+        const header = Header{
+            .magic = magic,
+            .version = version,
+            .file_count = @intCast(files.len),
+            .name_count = @intCast(names.len),
+            .declaration_count = @intCast(declarations.len),
+            .reference_count = @intCast(references.len),
+            .strings_len = @intCast(strings_len),
+        };
+        try writer.writeAll(std.mem.asBytes(&header));
+        try writer.writeAll(std.mem.sliceAsBytes(files));
+        try writer.writeAll(std.mem.sliceAsBytes(names));
+        try writer.writeAll(std.mem.sliceAsBytes(declarations));
+        try writer.writeAll(std.mem.sliceAsBytes(references));
+        try self.files.writePaths(writer);
+        for (sorted_names.items) |name|
+            try writer.writeAll(self.names.keys()[name]);
+    }
+
+    fn intern(self: *Builder, name: []const u8) !u32 {
+        const entry = try self.names.getOrPut(self.allocator, name);
+        if (!entry.found_existing)
+            entry.key_ptr.* = self.allocator.dupe(u8, name) catch |err| {
+                self.names.swapRemoveAt(entry.index);
+                return err;
+            };
+        return @intCast(entry.index);
+    }
+};
+
+fn recordLessThan(_: void, lhs: Record, rhs: Record) bool {
+    const order = std.math.order(lhs.symbol, rhs.symbol).differ() orelse
+        std.math.order(lhs.file, rhs.file).differ() orelse
+        std.math.order(lhs.row, rhs.row).differ() orelse
+        std.math.order(lhs.column, rhs.column);
+    return order == .lt;
+}
+
+pub const View = struct {
+    files: []const FileEntry,
+    names: []const Span,
+    declarations: []const Record,
+    references: []const Record,
+    strings: []const u8,
+
+    pub fn init(bytes: []align(@alignOf(FileEntry)) const u8) !View {
+        if (bytes.len < @sizeOf(Header))
+            return error.InvalidIndex;
+        const header = std.mem.bytesToValue(Header, bytes[0..@sizeOf(Header)]);
+        if (!std.mem.eql(u8, &header.magic, &magic) or header.version != version)
+            return error.InvalidIndex;
+        var offset: usize = @sizeOf(Header);
+        const files = try shared.section(FileEntry, bytes, &offset, header.file_count);
+        const names = try shared.section(Span, bytes, &offset, header.name_count);
+        const declarations = try shared.section(
+            Record,
+            bytes,
+            &offset,
+            header.declaration_count,
+        );
+        const references = try shared.section(
+            Record,
+            bytes,
+            &offset,
+            header.reference_count,
+        );
+        if (bytes.len - offset < header.strings_len)
+            return error.InvalidIndex;
+        return .{
+            .files = files,
+            .names = names,
+            .declarations = declarations,
+            .references = references,
+            .strings = bytes[offset..][0..header.strings_len],
+        };
+    }
+
+    pub fn lookup(self: View, name: []const u8) !?u32 {
+        var low: usize = 0;
+        var high = self.names.len;
+        while (low < high) {
+            const middle = low + (high - low) / 2;
+            switch (std.mem.order(u8, try self.string(self.names[middle]), name)) {
+                .lt => low = middle + 1,
+                .gt => high = middle,
+                .eq => return @intCast(middle),
+            }
+        }
+        return null;
+    }
+
+    pub fn records(self: View, kind: Kind) []const Record {
+        return switch (kind) {
+            .declaration => self.declarations,
+            .reference => self.references,
+        };
+    }
+
+    pub fn find(self: View, kind: Kind, symbol: u32) ![]const Record {
+        const all = self.records(kind);
+        const start = lowerBound(all, symbol);
+        const found = all[start..lowerBound(all, symbol + 1)];
+        for (found) |record|
+            if (record.symbol != symbol or record.file >= self.files.len)
+                return error.InvalidIndex;
+        return found;
+    }
+
+    pub fn path(self: View, file: u32) ![]const u8 {
+        if (file >= self.files.len)
+            return error.InvalidIndex;
+        return self.string(self.files[file].path);
+    }
+
+    fn string(self: View, span: Span) ![]const u8 {
+        if (!shared.fits(span, self.strings.len))
+            return error.InvalidIndex;
+        return self.strings[span.offset..][0..span.len];
+    }
+};
+
+fn lowerBound(all: []const Record, symbol: u32) usize {
+    var low: usize = 0;
+    var high = all.len;
+    while (low < high) {
+        const middle = low + (high - low) / 2;
+        if (all[middle].symbol < symbol)
+            low = middle + 1
+        else
+            high = middle;
+    }
+    return low;
+}
+
+fn expectOccurrences(src: []const u8, expected: []const Occurrence) !void {
+    const result = try lexer.tokenize(testing.allocator, src);
+    defer result.destroy(testing.allocator);
+    const occurrences = try collect(testing.allocator, result.locations);
+    defer testing.allocator.free(occurrences);
+    try testing.expectEqualDeep(expected, occurrences);
+}
+
+test "collects let declarations and references" {
+    try expectOccurrences(
+        \\link standard/io;
+        \\let ?*name = nil as ?*@string;
+        \\name?.capitalize;
+    ,
+        &.{
+            .{ .name = "name", .kind = .declaration, .row = 1, .column = 6 },
+            .{ .name = "@string", .kind = .reference, .row = 1, .column = 22 },
+            .{ .name = "name", .kind = .reference, .row = 2, .column = 0 },
+            .{ .name = "capitalize", .kind = .reference, .row = 2, .column = 6 },
+        },
+    );
+}
+
+test "collects type and struct field declarations" {
+    try expectOccurrences(
+        \\let @linked_list.node init @element = struct {
+        \\  element:&@element,
+        \\}
+    ,
+        &.{
+            .{
+                .name = "@linked_list.node",
+                .kind = .declaration,
+                .row = 0,
+                .column = 4,
+            },
+            .{ .name = "init", .kind = .reference, .row = 0, .column = 22 },
+            .{ .name = "@element", .kind = .reference, .row = 0, .column = 27 },
+            .{ .name = "element", .kind = .declaration, .row = 1, .column = 2 },
+            .{ .name = "@element", .kind = .reference, .row = 1, .column = 11 },
+        },
+    );
+}
+
+test "detaches names from the source" {
+    const src = try testing.allocator.dupe(u8, "let head = tail;");
+    const result = try lexer.tokenize(testing.allocator, src);
+    defer result.destroy(testing.allocator);
+    const occurrences = try collect(testing.allocator, result.locations);
+    defer testing.allocator.free(occurrences);
+    const strings = try detach(testing.allocator, occurrences);
+    defer testing.allocator.free(strings);
+    @memset(src, ' ');
+    testing.allocator.free(src);
+    try testing.expectEqualStrings("headtail", strings);
+    try testing.expectEqualStrings("head", occurrences[0].name);
+    try testing.expectEqualStrings("tail", occurrences[1].name);
+}
+
+test "writes and queries an index" {
+    var builder = Builder.init(testing.allocator);
+    defer builder.deinit();
+    try builder.update("a.helena", 1, &.{
+        .{ .name = "head", .kind = .declaration, .row = 2, .column = 4 },
+        .{ .name = "length", .kind = .declaration, .row = 3, .column = 4 },
+    });
+    try builder.update("b.helena", 2, &.{
+        .{ .name = "head", .kind = .reference, .row = 7, .column = 9 },
+        .{ .name = "head", .kind = .reference, .row = 1, .column = 0 },
+    });
+    try builder.update("c.helena", 3, &.{
+        .{ .name = "tail", .kind = .reference, .row = 0, .column = 0 },
+    });
+    builder.retain(&.{ "a.helena", "b.helena" });
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    try builder.write(&output.writer);
+    const bytes = try testing.allocator.alignedAlloc(
+        u8,
+        .of(FileEntry),
+        output.written().len,
+    );
+    defer testing.allocator.free(bytes);
+    @memcpy(bytes, output.written());
+    const view = try View.init(bytes);
+    try testing.expectEqual(null, try view.lookup("tail"));
+    const head = (try view.lookup("head")).?;
+    const declarations = try view.find(.declaration, head);
+    try testing.expectEqual(1, declarations.len);
+    try testing.expectEqualStrings("a.helena", try view.path(declarations[0].file));
+    try testing.expectEqualSlices(
+        Record,
+        &.{
+            .{ .symbol = head, .file = 1, .row = 1, .column = 0 },
+            .{ .symbol = head, .file = 1, .row = 7, .column = 9 },
+        },
+        try view.find(.reference, head),
+    );
+    var reloaded = Builder.init(testing.allocator);
+    defer reloaded.deinit();
+    try reloaded.load(view);
+    try testing.expectEqual(2, reloaded.modified("b.helena"));
+    try testing.expectEqual(null, reloaded.modified("c.helena"));
+}
+
+test "rejects truncated indexes" {
+    const bytes = try testing.allocator.alignedAlloc(u8, .of(FileEntry), 8);
+    defer testing.allocator.free(bytes);
+    @memset(bytes, 0);
+    try testing.expectError(error.InvalidIndex, View.init(bytes));
+}
+
+test "checks only the records it returns" {
+    var builder = Builder.init(testing.allocator);
+    defer builder.deinit();
+    try builder.update("a.helena", 1, &.{
+        .{ .name = "head", .kind = .declaration, .row = 0, .column = 4 },
+        .{ .name = "tail", .kind = .declaration, .row = 1, .column = 4 },
+    });
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    try builder.write(&output.writer);
+    const bytes = try testing.allocator.alignedAlloc(
+        u8,
+        .of(FileEntry),
+        output.written().len,
+    );
+    defer testing.allocator.free(bytes);
+    @memcpy(bytes, output.written());
+    const offset = @sizeOf(Header) + @sizeOf(FileEntry) + 2 * @sizeOf(Span);
+    const declarations: []Record = @alignCast(std.mem.bytesAsSlice(
+        Record,
+        bytes[offset..][0 .. 2 * @sizeOf(Record)],
+    ));
+    declarations[1].file = 7;
+    const view = try View.init(bytes);
+    try testing.expectEqual(1, (try view.find(.declaration, 0)).len);
+    try testing.expectError(error.InvalidIndex, view.find(.declaration, 1));
+}
@@ -0,0 +1,595 @@
+const std = @import("std");
+const testing = std.testing;
+const lexer = @import("../lexer/lexer.zig");
+const shared = @import("index.zig");
+
+pub const Class = enum(u8) {
+    code,
+    literal,
+};
+pub const Match = struct {
+    row: u32,
+    column: u32,
+};
+
+const Span = shared.Span;
+const FileEntry = shared.FileEntry;
+const Entry = extern struct {
+    trigram: u32,
+    count: u32,
+    postings: Span,
+};
+const Header = extern struct {
+    magic: [4]u8,
+    version: u32,
+    file_count: u32,
+    trigram_count: u32,
+    postings_len: u32,
+    strings_len: u32,
+};
+
+const magic = "HTRI".*;
+const version = 1;
+
+pub fn collect(
+    allocator: std.mem.Allocator,
+    locations: []const lexer.Location,
+) ![]u32 {
+    var trigrams = std.ArrayList(u32).empty;
+    errdefer trigrams.deinit(allocator);
+    for (locations) |location| {
+        const class, const text = classify(location.token) orelse continue;
+        if (text.len < 3)
+            continue;
+        for (0..text.len - 2) |index|
+            try trigrams.append(allocator, trigram(class, text[index..][0..3]));
+    }
+    std.sort.pdq(u32, trigrams.items, {}, std.sort.asc(u32));
+    var len: usize = 0;
+    for (trigrams.items) |t| {
+        if (len > 0 and trigrams.items[len - 1] == t)
+            continue;
+        trigrams.items[len] = t;
+        len += 1;
+    }
+    trigrams.shrinkRetainingCapacity(len);
+    return trigrams.toOwnedSlice(allocator);
+}
+
+pub fn find(
+    allocator: std.mem.Allocator,
+    source: []const u8,
+    locations: []const lexer.Location,
+    query: []const u8,
+    include_literals: bool,
+) ![]Match {
+    var matches = std.ArrayList(Match).empty;
+    errdefer matches.deinit(allocator);
+    if (query.len == 0)
+        return matches.toOwnedSlice(allocator);
+    const delimiter_len = lexer.Token.literal_delimiter_len;
+    var literal: usize = 0;
+    var row: u32 = 0;
+    var line_start: usize = 0;
+    var scanned: usize = 0;
+    var start: usize = 0;
+    while (std.mem.indexOfPos(u8, source, start, query)) |offset| : (start = offset + 1) {
+        const end = offset + query.len;
+        const content: ?[2]usize = while (literal < locations.len) : (literal += 1) {
+            const text = switch (locations[literal].token) {
+                .literal => |text| text,
+                else => continue,
+            };
+            const content_start = @intFromPtr(text.ptr) - @intFromPtr(source.ptr);
+            if (content_start + text.len + delimiter_len > offset)
+                break .{ content_start, content_start + text.len };
+        } else null;
+        if (content) |range| {
+            const is_inside = range[0] <= offset and end <= range[1];
+            const is_outside = end <= range[0] - delimiter_len;
+            if (!is_outside and !(include_literals and is_inside))
+                continue;
+        }
+        for (source[scanned..offset], scanned..) |char, index| {
+            if (lexer.Token.isLineDelimiter(char)) {
+                row +|= 1;
+                line_start = index + 1;
+            }
+        }
+        scanned = offset;
+        try matches.append(allocator, .{
+            .row = row,
+            .column = @intCast(@min(offset - line_start, std.math.maxInt(u32))),
+        });
+    }
+    return matches.toOwnedSlice(allocator);
+}
+
+fn classify(token: lexer.Token) ?struct { Class, []const u8 } {
+    return switch (token) {
+        .identifier => |text| .{ .code, text },
+        .number => |number| .{ .code, number.text },
+        .let => .{ .code, "let" },
+        .link => .{ .code, "link" },
+        .literal => |text| .{ .literal, text },
+        else => null,
+    };
+}
+
+fn codeTrigrams(allocator: std.mem.Allocator, query: []const u8) ![]u32 {
+    const result = try lexer.tokenize(allocator, query);
+    defer result.destroy(allocator);
+    var trigrams = std.ArrayList(u32).empty;
+    errdefer trigrams.deinit(allocator);
+    for (result.locations, 0..) |location, index| {
+        const class, const text = classify(location.token) orelse continue;
+        if (class != .code or text.len < 3)
+            continue;
+        // "3.5" may be the tail of "x3.5", which the lexer splits at the dot.
+        if (index == 0 and location.token == .number and
+            !location.token.number.isInteger())
+            continue;
+        for (0..text.len - 2) |offset|
+            try trigrams.append(allocator, trigram(class, text[offset..][0..3]));
+    }
+    return trigrams.toOwnedSlice(allocator);
+}
+
+fn trigram(class: Class, text: *const [3]u8) u32 {
+    return @as(u32, @intFromEnum(class)) << 24 |
+        @as(u32, text[0]) << 16 |
+        @as(u32, text[1]) << 8 |
+        text[2];
+}
+
+pub const Builder = struct {
+    allocator: std.mem.Allocator,
+    files: shared.FileTable(u32),
+
+    const Posting = struct {
+        trigram: u32,
+        file: u32,
+    };
+
+    pub fn init(allocator: std.mem.Allocator) Builder {
+        return .{ .allocator = allocator, .files = .empty };
+    }
+
+    pub fn deinit(self: *Builder) void {
+        self.files.deinit(self.allocator);
+    }
+
+    pub fn load(self: *Builder, view: View) !void {
+        for (view.files) |file|
+            (try self.files.itemsOf(
+                self.allocator,
+                view.string(file.path),
+                file.modified,
+            )).clearRetainingCapacity();
+        for (view.entries) |entry| {
+            var postings = view.postingsOf(entry);
+            while (try postings.next()) |file| {
+                const path = view.path(file);
+                try self.files.entries.getPtr(path).?.items.append(
+                    self.allocator,
+                    entry.trigram,
+                );
+            }
+        }
+    }
+
+    pub fn modified(self: *const Builder, path: []const u8) ?i64 {
+        return self.files.modifiedAt(path);
+    }
+
+    pub fn update(
+        self: *Builder,
+        path: []const u8,
+        modified_at: i64,
+        trigrams: []const u32,
+    ) !void {
+        const list = try self.files.itemsOf(self.allocator, path, modified_at);
+        list.clearRetainingCapacity();
+        try list.appendSlice(self.allocator, trigrams);
+    }
+
+    pub fn retain(self: *Builder, paths: []const []const u8) void {
+        self.files.retain(self.allocator, paths);
+    }
+
+    pub fn write(self: *const Builder, writer: *std.Io.Writer) !void {
+        const allocator = self.allocator;
+        var postings = std.ArrayList(Posting).empty;
+        defer postings.deinit(allocator);
+        for (self.files.entries.values(), 0..) |file, index|
+            for (file.items.items) |t|
+                try postings.append(allocator, .{
+                    .trigram = t,
+                    .file = @intCast(index),
+                });
+        std.sort.pdq(Posting, postings.items, {}, struct {
+            fn lessThan(_: void, lhs: Posting, rhs: Posting) bool {
+                return if (lhs.trigram == rhs.trigram)
+                    lhs.file < rhs.file
+                else
+                    lhs.trigram < rhs.trigram;
+            }
+        }.lessThan);
+        var entries = std.ArrayList(Entry).empty;
+        defer entries.deinit(allocator);
+        var encoded = std.ArrayList(u8).empty;
+        defer encoded.deinit(allocator);
+        var previous_file: u32 = 0;
+        for (postings.items, 0..) |posting, index| {
+            if (index == 0 or postings.items[index - 1].trigram != posting.trigram) {
+                try entries.append(allocator, .{
+                    .trigram = posting.trigram,
+                    .count = 0,
+                    .postings = .{ .offset = @intCast(encoded.items.len), .len = 0 },
+                });
+                previous_file = 0;
+            }
+            const entry = &entries.items[entries.items.len - 1];
+            try appendVarint(allocator, &encoded, posting.file - previous_file);
+            previous_file = posting.file;
+            entry.count += 1;
+            entry.postings.len = @as(u32, @intCast(encoded.items.len)) -
+                entry.postings.offset;
+        }
+        var strings_len: usize = 0;
+        const files = try self.files.fileEntries(allocator, &strings_len);
+        defer allocator.free(files);
+        const header = Header{
+            .magic = magic,
+            .version = version,
+            .file_count = @intCast(files.len),
+            .trigram_count = @intCast(entries.items.len),
+            .postings_len = @intCast(encoded.items.len),
+            .strings_len = @intCast(strings_len),
+        };
+        try writer.writeAll(std.mem.asBytes(&header));
+        try writer.writeAll(std.mem.sliceAsBytes(files));
+        try writer.writeAll(std.mem.sliceAsBytes(entries.items));
+        try writer.writeAll(encoded.items);
+        try self.files.writePaths(writer);
+    }
+};
+
+fn appendVarint(
+    allocator: std.mem.Allocator,
+    bytes: *std.ArrayList(u8),
+    value: u32,
+) !void {
+    var remaining = value;
+    while (remaining >= 0x80) : (remaining >>= 7)
+        try bytes.append(allocator, @as(u8, @truncate(remaining)) | 0x80);
+    try bytes.append(allocator, @intCast(remaining));
+}
+
+const Postings = struct {
+    bytes: []const u8,
+    index: usize,
+    file: u32,
+    file_count: usize,
+
+    fn next(self: *Postings) !?u32 {
+        if (self.index == self.bytes.len)
+            return null;
+        var delta: u32 = 0;
+        var shift: u5 = 0;
+        while (true) : (shift += 7) {
+            if (self.index == self.bytes.len)
+                return error.InvalidIndex;
+            const byte = self.bytes[self.index];
+            self.index += 1;
+            delta |= @as(u32, byte & 0x7f) << shift;
+            if (byte & 0x80 == 0)
+                break;
+            if (shift >= 28)
+                return error.InvalidIndex;
+        }
+        if (delta >= self.file_count - self.file)
+            return error.InvalidIndex;
+        self.file += delta;
+        return self.file;
+    }
+};
+
+pub const View = struct {
+    files: []const FileEntry,
+    entries: []const Entry,
+    postings: []const u8,
+    strings: []const u8,
+
+    pub fn init(bytes: []align(@alignOf(FileEntry)) const u8) !View {
+        if (bytes.len < @sizeOf(Header))
+            return error.InvalidIndex;
+        const header = std.mem.bytesToValue(Header, bytes[0..@sizeOf(Header)]);
+        if (!std.mem.eql(u8, &header.magic, &magic) or header.version != version)
+            return error.InvalidIndex;
+        var offset: usize = @sizeOf(Header);
+        const files = try shared.section(FileEntry, bytes, &offset, header.file_count);
+        const entries = try shared.section(Entry, bytes, &offset, header.trigram_count);
+        if (bytes.len - offset < @as(usize, header.postings_len) + header.strings_len)
+            return error.InvalidIndex;
+        const view = View{
+            .files = files,
+            .entries = entries,
+            .postings = bytes[offset..][0..header.postings_len],
+            .strings = bytes[offset + header.postings_len ..][0..header.strings_len],
+        };
+        for (files) |file|
+            if (!shared.fits(file.path, view.strings.len))
+                return error.InvalidIndex;
+        for (entries) |entry|
+            if (!shared.fits(entry.postings, view.postings.len))
+                return error.InvalidIndex;
+        return view;
+    }
+
+    pub fn candidates(
+        self: View,
+        allocator: std.mem.Allocator,
+        query: []const u8,
+        include_literals: bool,
+    ) ![]u32 {
+        const code_trigrams = try codeTrigrams(allocator, query);
+        defer allocator.free(code_trigrams);
+        const code = try self.intersect(allocator, code_trigrams);
+        if (!include_literals)
+            return code;
+        defer allocator.free(code);
+        const literal_trigrams = try allocator.alloc(u32, query.len -| 2);
+        defer allocator.free(literal_trigrams);
+        for (literal_trigrams, 0..) |*t, index|
+            t.* = trigram(.literal, query[index..][0..3]);
+        const literal = try self.intersect(allocator, literal_trigrams);
+        defer allocator.free(literal);
+        var merged = try std.ArrayList(u32).initCapacity(
+            allocator,
+            code.len + literal.len,
+        );
+        var i: usize = 0;
+        var j: usize = 0;
+        while (i < code.len or j < literal.len) {
+            const file = if (j == literal.len or (i < code.len and code[i] <= literal[j]))
+                code[i]
+            else
+                literal[j];
+            if (i < code.len and code[i] == file)
+                i += 1;
+            if (j < literal.len and literal[j] == file)
+                j += 1;
+            merged.appendAssumeCapacity(file);
+        }
+        return merged.toOwnedSlice(allocator);
+    }
+
+    pub fn path(self: View, file: u32) []const u8 {
+        return self.string(self.files[file].path);
+    }
+
+    fn intersect(
+        self: View,
+        allocator: std.mem.Allocator,
+        trigrams: []const u32,
+    ) ![]u32 {
+        if (trigrams.len == 0) {
+            const all = try allocator.alloc(u32, self.files.len);
+            for (all, 0..) |*file, index|
+                file.* = @intCast(index);
+            return all;
+        }
+        const entries = try allocator.alloc(Entry, trigrams.len);
+        defer allocator.free(entries);
+        for (entries, trigrams) |*entry, t|
+            entry.* = self.entryOf(t) orelse return allocator.alloc(u32, 0);
+        std.sort.pdq(Entry, entries, {}, struct {
+            fn lessThan(_: void, lhs: Entry, rhs: Entry) bool {
+                return lhs.count < rhs.count;
+            }
+        }.lessThan);
+        var result = std.ArrayList(u32).empty;
+        errdefer result.deinit(allocator);
+        var postings = self.postingsOf(entries[0]);
+        while (try postings.next()) |file|
+            try result.append(allocator, file);
+        for (entries[1..]) |entry| {
+            var others = self.postingsOf(entry);
+            var other = try others.next();
+            var len: usize = 0;
+            for (result.items) |file| {
+                while (other != null and other.? < file)
+                    other = try others.next();
+                if (other == null)
+                    break;
+                if (other.? == file) {
+                    result.items[len] = file;
+                    len += 1;
+                }
+            }
+            result.shrinkRetainingCapacity(len);
+            if (len == 0)
+                break;
+        }
+        return result.toOwnedSlice(allocator);
+    }
+
+    fn entryOf(self: View, t: u32) ?Entry {
+        var low: usize = 0;
+        var high = self.entries.len;
+        while (low < high) {
+            const middle = low + (high - low) / 2;
+            switch (std.math.order(self.entries[middle].trigram, t)) {
+                .lt => low = middle + 1,
+                .gt => high = middle,
+                .eq => return self.entries[middle],
+            }
+        }
+        return null;
+    }
+
+    fn postingsOf(self: View, e: Entry) Postings {
+        return .{
+            .bytes = self.postings[e.postings.offset..][0..e.postings.len],
+            .index = 0,
+            .file = 0,
+            .file_count = self.files.len,
+        };
+    }
+
+    fn string(self: View, span: Span) []const u8 {
+        return self.strings[span.offset..][0..span.len];
+    }
+};
+
+fn tokenizeAndCollect(src: []const u8) ![]u32 {
+    const result = try lexer.tokenize(testing.allocator, src);
+    defer result.destroy(testing.allocator);
+    return collect(testing.allocator, result.locations);
+}
+
+fn writeView(builder: *const Builder) ![]align(@alignOf(FileEntry)) u8 {
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    try builder.write(&output.writer);
+    const bytes = try testing.allocator.alignedAlloc(
+        u8,
+        .of(FileEntry),
+        output.written().len,
+    );
+    @memcpy(bytes, output.written());
+    return bytes;
+}
+
+test "collects distinct trigrams per token class" {
+    const trigrams = try tokenizeAndCollect("head head \"head\"");
+    defer testing.allocator.free(trigrams);
+    try testing.expectEqualSlices(u32, &.{
+        trigram(.code, "ead"),
+        trigram(.code, "hea"),
+        trigram(.literal, "ead"),
+        trigram(.literal, "hea"),
+    }, trigrams);
+}
+
+fn expectFind(
+    source: []const u8,
+    query: []const u8,
+    include_literals: bool,
+    expected: []const Match,
+) !void {
+    const result = try lexer.tokenize(testing.allocator, source);
+    defer result.destroy(testing.allocator);
+    const matches = try find(
+        testing.allocator,
+        source,
+        result.locations,
+        query,
+        include_literals,
+    );
+    defer testing.allocator.free(matches);
+    try testing.expectEqualSlices(Match, expected, matches);
+}
+
+test "finds matches inside tokens" {
+    const source = "let ?&head = _head;\nprint \"a head\nhead\"";
+    const result = try lexer.tokenize(testing.allocator, source);
+    defer result.destroy(testing.allocator);
+    const code = try find(testing.allocator, source, result.locations, "head", false);
+    defer testing.allocator.free(code);
+    try testing.expectEqualSlices(Match, &.{
+        .{ .row = 0, .column = 6 },
+        .{ .row = 0, .column = 14 },
+    }, code);
+    const all = try find(testing.allocator, source, result.locations, "head", true);
+    defer testing.allocator.free(all);
+    try testing.expectEqualSlices(Match, &.{
+        .{ .row = 0, .column = 6 },
+        .{ .row = 0, .column = 14 },
+        .{ .row = 1, .column = 9 },
+        .{ .row = 2, .column = 0 },
+    }, all);
+}
+
+test "finds matches across tokens" {
+    const source = "let ?&head = _head;\nprint \"a head\nhead\"";
+    try expectFind(source, "?&head = _", false, &.{.{ .row = 0, .column = 4 }});
+    try expectFind(source, "head;", false, &.{.{ .row = 0, .column = 14 }});
+    try expectFind(source, "let ?", false, &.{.{ .row = 0, .column = 0 }});
+    try expectFind(source, "a head\nhead", true, &.{.{ .row = 1, .column = 7 }});
+    try expectFind(source, "t \"a", true, &.{});
+    try expectFind(source, "head\"", true, &.{});
+}
+
+test "narrows candidates by intersecting posting lists" {
+    var builder = Builder.init(testing.allocator);
+    defer builder.deinit();
+    const sources = [_][]const u8{
+        "let head = 1",
+        "print \"head\"",
+        "let header = 2",
+        "let tail = 3",
+    };
+    for (sources, 0..) |src, index| {
+        const trigrams = try tokenizeAndCollect(src);
+        defer testing.allocator.free(trigrams);
+        var path: [1]u8 = .{'a' + @as(u8, @intCast(index))};
+        try builder.update(&path, @intCast(index), trigrams);
+    }
+    const bytes = try writeView(&builder);
+    defer testing.allocator.free(bytes);
+    const view = try View.init(bytes);
+    const code = try view.candidates(testing.allocator, "head", false);
+    defer testing.allocator.free(code);
+    try testing.expectEqualSlices(u32, &.{ 0, 2 }, code);
+    const all = try view.candidates(testing.allocator, "head", true);
+    defer testing.allocator.free(all);
+    try testing.expectEqualSlices(u32, &.{ 0, 1, 2 }, all);
+    const phrase = try view.candidates(testing.allocator, "let head", false);
+    defer testing.allocator.free(phrase);
+    try testing.expectEqualSlices(u32, &.{ 0, 2 }, phrase);
+    const none = try view.candidates(testing.allocator, "body", true);
+    defer testing.allocator.free(none);
+    try testing.expectEqual(0, none.len);
+    var reloaded = Builder.init(testing.allocator);
+    defer reloaded.deinit();
+    try reloaded.load(view);
+    try testing.expectEqualSlices(
+        u32,
+        builder.files.entries.get("c").?.items.items,
+        reloaded.files.entries.get("c").?.items.items,
+    );
+}
+
+test "encodes posting deltas as varints" {
+    var bytes = std.ArrayList(u8).empty;
+    defer bytes.deinit(testing.allocator);
+    try appendVarint(testing.allocator, &bytes, 1);
+    try appendVarint(testing.allocator, &bytes, 300);
+    try testing.expectEqualSlices(u8, &.{ 0x01, 0xac, 0x02 }, bytes.items);
+    var postings = Postings{
+        .bytes = bytes.items,
+        .index = 0,
+        .file = 0,
+        .file_count = 302,
+    };
+    try testing.expectEqual(1, try postings.next());
+    try testing.expectEqual(301, try postings.next());
+    try testing.expectEqual(null, try postings.next());
+}
+
+test "rejects posting deltas past the file table" {
+    var bytes = std.ArrayList(u8).empty;
+    defer bytes.deinit(testing.allocator);
+    try appendVarint(testing.allocator, &bytes, 1);
+    try appendVarint(testing.allocator, &bytes, std.math.maxInt(u32));
+    var postings = Postings{
+        .bytes = bytes.items,
+        .index = 0,
+        .file = 0,
+        .file_count = 2,
+    };
+    try testing.expectEqual(1, try postings.next());
+    try testing.expectError(error.InvalidIndex, postings.next());
+}
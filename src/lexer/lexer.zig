@@ -1,7 +1,9 @@
 const std = @import("std");
 const testing = std.testing;
 const tokens = @import("tokens.zig");
-const Token = tokens.Token;
+const trace = @import("../trace/trace.zig");
+const memory = @import("../memory/memory.zig");
+pub const Token = tokens.Token;
 
 pub const TokenizationResult = struct {
     locations: []const Location,
@@ -20,20 +22,20 @@ pub const TokenizationResult = struct {
 };
 pub const Location = struct {
     token: Token,
-    row: usize,
-    column: usize,
+    row: u32,
+    column: u32,
 };
 pub const Diagnostic = union(enum) {
     unterminated_literal: struct {
-        row: usize,
-        column: usize,
+        row: u32,
+        column: u32,
     },
 };
 
 const Context = union(enum) {
     literal: struct {
-        row: usize,
-        column: usize,
+        row: u32,
+        column: u32,
         index: usize,
     },
 };
@@ -47,17 +49,21 @@ pub fn tokenize(
     allocator: std.mem.Allocator,
     src: []const u8,
 ) !*const TokenizationResult {
+    const span = trace.begin("tokenize");
+    defer span.end();
+    const phase = memory.enter(.lexing);
+    defer phase.exit();
     if (src.len == 0)
         return &empty_tokenization_result;
     var context: ?Context = null;
     var locations = std.ArrayList(Location).empty;
     var diagnostics = std.ArrayList(Diagnostic).empty;
     const result = try allocator.create(TokenizationResult);
-    var row: usize = 0;
-    var column: usize = 0;
+    var row: u32 = 0;
+    var column: u32 = 0;
     var word_index: ?usize = null;
     var character_index: usize = 0;
-    errdefer result.destroy(allocator);
+    errdefer allocator.destroy(result);
     errdefer locations.deinit(allocator);
     errdefer diagnostics.deinit(allocator);
     while (true) : (character_index += 1) {
@@ -103,32 +109,42 @@ pub fn tokenize(
                     }),
             }
         } else {
-            if (word_index) |word_idx| {
-                const text = src[word_idx..character_index];
-                if (Token.word(text)) |word|
-                    try locations.append(allocator, .{
-                        .token = word,
-                        .row = row,
-                        .column = column -| text.len,
-                    });
-            }
-            if (character) |char| {
-                if (Token.separator(char)) |separator| {
-                    try locations.append(allocator, .{
-                        .token = separator,
-                        .row = row,
-                        .column = column,
-                    });
+            const boundary = if (character) |char|
+                Token.separator(char) orelse
+                    if (isDecimalPoint(src, word_index, character_index))
+                        null
+                    else
+                        Token.punctuation(char)
+            else
+                null;
+            if (character == null or boundary != null) {
+                if (word_index) |word_idx| {
+                    const text = src[word_idx..character_index];
+                    if (Token.word(text)) |word|
+                        try locations.append(allocator, .{
+                            .token = word,
+                            .row = row,
+                            .column = column -| @as(
+                                u32,
+                                @intCast(@min(text.len, std.math.maxInt(u32))),
+                            ),
+                        });
                 }
+                word_index = null;
             }
-            word_index = null;
+            if (boundary) |b|
+                try locations.append(allocator, .{
+                    .token = b,
+                    .row = row,
+                    .column = column,
+                });
         }
         if (character) |char| {
             if (Token.isLineDelimiter(char)) {
-                row += 1;
+                row +|= 1;
                 column = 0;
             } else {
-                column += 1;
+                column +|= 1;
             }
         } else {
             break;
@@ -141,12 +157,34 @@ pub fn tokenize(
     return result;
 }
 
+fn isDecimalPoint(src: []const u8, word_index: ?usize, index: usize) bool {
+    const start = word_index orelse return false;
+    if (src[index] != '.' or start == index or index + 1 == src.len or
+        !std.ascii.isDigit(src[index + 1]))
+        return false;
+    for (src[start..index]) |char|
+        if (!std.ascii.isDigit(char))
+            return false;
+    return true;
+}
+
+test {
+    _ = tokens;
+}
+
 test "returns empty slice for empty source" {
     const result = try tokenize(std.testing.allocator, "");
     try testing.expectEqual(empty_tokenization_result, result.*);
     _ = result.destroy(std.testing.allocator);
 }
 
+test "packs locations into half a cache line" {
+    if (@sizeOf(usize) != 8)
+        return error.SkipZigTest;
+    try testing.expectEqual(24, @sizeOf(Token));
+    try testing.expectEqual(32, @sizeOf(Location));
+}
+
 test "tokenizes literal" {
     const result = try tokenize(
         std.testing.allocator,
@@ -166,6 +204,30 @@ test "tokenizes literal" {
     _ = result.destroy(std.testing.allocator);
 }
 
+test "tokenizes words between separators" {
+    const result = try tokenize(std.testing.allocator, "let n 7\nlink");
+    try testing.expectEqualDeep(
+        TokenizationResult{
+            .locations = &.{
+                .{ .token = .let, .row = 0, .column = 0 },
+                .{ .token = .whitespace, .row = 0, .column = 3 },
+                .{ .token = .{ .identifier = "n" }, .row = 0, .column = 4 },
+                .{ .token = .whitespace, .row = 0, .column = 5 },
+                .{
+                    .token = .{ .number = .{ .text = "7" } },
+                    .row = 0,
+                    .column = 6,
+                },
+                .{ .token = .newline, .row = 0, .column = 7 },
+                .{ .token = .link, .row = 1, .column = 0 },
+            },
+            .diagnostics = &.{},
+        },
+        result.*,
+    );
+    _ = result.destroy(std.testing.allocator);
+}
+
 test "tokenizes link" {
     const result = try tokenize(
         std.testing.allocator,
@@ -197,21 +259,25 @@ test "tokenizes 'hello, world' source" {
         \\   print message;
         \\ }
     );
+    defer result.destroy(std.testing.allocator);
     var _tokens = try std.ArrayList(Token).initCapacity(
         std.testing.allocator,
         result.locations.len,
     );
+    defer _tokens.deinit(std.testing.allocator);
     for (result.locations) |location|
         try _tokens.append(std.testing.allocator, location.token);
-    try testing.expectEqualSlices(
-        Token,
-        &[_]Token{
+    try testing.expectEqualDeep(
+        @as([]const Token, &.{
+            .whitespace,
             .link,
             .whitespace,
             .{ .identifier = "standard/io" },
             .newline,
             .newline,
+            .whitespace,
             .let,
+            .whitespace,
             .{ .identifier = "main" },
             .whitespace,
             .{ .identifier = "_" },
@@ -225,6 +291,7 @@ test "tokenizes 'hello, world' source" {
             .newline,
             .whitespace,
             .whitespace,
+            .whitespace,
             .let,
             .whitespace,
             .{ .identifier = "message" },
@@ -236,12 +303,42 @@ test "tokenizes 'hello, world' source" {
             .newline,
             .whitespace,
             .whitespace,
+            .whitespace,
             .{ .identifier = "print" },
             .whitespace,
             .{ .identifier = "message" },
-        },
+            .semicolon,
+            .newline,
+            .whitespace,
+            .right_curly_brace,
+        }),
         _tokens.items,
     );
-    _ = result.destroy(std.testing.allocator);
-    tokens.deinit(std.testing.allocator);
+}
+
+test "splits words at punctuation but not at decimal points" {
+    const result = try tokenize(std.testing.allocator, "name?.size 3.14 0.range");
+    defer result.destroy(std.testing.allocator);
+    try testing.expectEqualDeep(
+        @as([]const Location, &.{
+            .{ .token = .{ .identifier = "name?" }, .row = 0, .column = 0 },
+            .{ .token = .dot, .row = 0, .column = 5 },
+            .{ .token = .{ .identifier = "size" }, .row = 0, .column = 6 },
+            .{ .token = .whitespace, .row = 0, .column = 10 },
+            .{
+                .token = .{ .number = .{ .text = "3.14" } },
+                .row = 0,
+                .column = 11,
+            },
+            .{ .token = .whitespace, .row = 0, .column = 15 },
+            .{
+                .token = .{ .number = .{ .text = "0" } },
+                .row = 0,
+                .column = 16,
+            },
+            .{ .token = .dot, .row = 0, .column = 17 },
+            .{ .token = .{ .identifier = "range" }, .row = 0, .column = 18 },
+        }),
+        result.locations,
+    );
 }
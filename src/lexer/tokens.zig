@@ -16,10 +16,7 @@ pub const Token = union(enum) {
     link,
     literal: []const u8,
     newline,
-    number: struct {
-        text: []const u8,
-        is_integer: bool,
-    },
+    number: Number,
     right_curly_brace,
     right_parenthesis,
     right_square_bracket,
@@ -29,6 +26,26 @@ pub const Token = union(enum) {
 
     pub const literal_delimiter_len = 1;
 
+    pub const Number = struct {
+        text: []const u8,
+
+        pub const Value = union(enum) {
+            integer: u64,
+            float: f64,
+        };
+
+        pub fn isInteger(self: Number) bool {
+            return std.mem.indexOfScalar(u8, self.text, '.') == null;
+        }
+
+        pub fn value(self: Number) error{ Overflow, InvalidCharacter }!Value {
+            return if (self.isInteger())
+                .{ .integer = try std.fmt.parseInt(u64, self.text, 10) }
+            else
+                .{ .float = try std.fmt.parseFloat(f64, self.text) };
+        }
+    };
+
     pub fn format(
         self: Token,
         comptime _: []const u8,
@@ -44,23 +61,10 @@ pub const Token = union(enum) {
                 ".literal = \"{}\"",
                 .{std.fmt.fmtSliceEscapeUpper(t)},
             ),
-            .number => |t| writer.print(".number = {d}", .{
-                if (t.is_integer)
-                    std.fmt.parseInt(isize, t.text, 10)
-                else _: {
-                    const decimal_len = t.text.len - std.mem.indexOfScalar(
-                        u8,
-                        &t.text,
-                        '.',
-                    );
-                    break :_ if (decimal_len <= 7)
-                        std.fmt.parseFloat(f32, t.text)
-                    else if (decimal_len <= 16)
-                        std.fmt.parseFloat(f64, t.text)
-                    else
-                        std.fmt.parseFloat(f128, t.text);
-                },
-            }),
+            .number => |t| switch (try t.value()) {
+                .integer => |v| writer.print(".number = {d}", .{v}),
+                .float => |v| writer.print(".number = {d}", .{v}),
+            },
             else => writer.writeAll(@tagName(self)),
         };
     }
@@ -85,23 +89,30 @@ pub const Token = union(enum) {
             .{ .identifier = text };
     }
 
+    pub fn punctuation(text: u8) ?Token {
+        return if (separator(text) != null)
+            null
+        else
+            staticWord(&.{text});
+    }
+
     pub fn isLiteralDelimiter(self: u8) bool {
         return self == '"';
     }
 
     fn findNumber(text: []const u8) ?Token {
-        var is_integer = true;
+        var has_point = false;
         for (text, 0..) |char, index| {
             if (index > 0 and char == '.') {
-                if (is_integer) {
-                    is_integer = false;
+                if (!has_point) {
+                    has_point = true;
                 } else {
                     break;
                 }
             } else if (!std.ascii.isDigit(char))
                 break;
             if (index == text.len - 1)
-                return .{ .number = .{ .text = text, .is_integer = is_integer } };
+                return .{ .number = .{ .text = text } };
         }
         return null;
     }
@@ -147,15 +158,39 @@ test "word" {
         Token.word("helena"),
     );
     try std.testing.expectEqualDeep(
-        Token{ .number = .{ .text = "2003", .is_integer = true } },
+        Token{ .number = .{ .text = "2003" } },
         Token.word("2003"),
     );
     try std.testing.expectEqualDeep(
-        Token{ .number = .{ .text = "3.14", .is_integer = false } },
+        Token{ .number = .{ .text = "3.14" } },
         Token.word("3.14"),
     );
 }
 
+test "Number.isInteger" {
+    try std.testing.expect((Token.Number{ .text = "2003" }).isInteger());
+    try std.testing.expect(!(Token.Number{ .text = "3.14" }).isInteger());
+}
+
+test "Number.value" {
+    try std.testing.expectEqual(
+        Token.Number.Value{ .integer = 2003 },
+        try (Token.Number{ .text = "2003" }).value(),
+    );
+    try std.testing.expectEqual(
+        Token.Number.Value{ .integer = std.math.maxInt(u64) },
+        try (Token.Number{ .text = "18446744073709551615" }).value(),
+    );
+    try std.testing.expectError(
+        error.Overflow,
+        (Token.Number{ .text = "18446744073709551616" }).value(),
+    );
+    try std.testing.expectEqual(
+        Token.Number.Value{ .float = 3.14 },
+        try (Token.Number{ .text = "3.14" }).value(),
+    );
+}
+
 test "staticWord" {
     try std.testing.expectEqualDeep(null, Token.staticWord(""));
     try std.testing.expectEqualDeep(.asterisk, Token.staticWord("*"));
@@ -194,6 +229,14 @@ test "separator" {
         );
 }
 
+test "punctuation" {
+    try std.testing.expectEqualDeep(.colon, Token.punctuation(':'));
+    try std.testing.expectEqualDeep(.dot, Token.punctuation('.'));
+    try std.testing.expectEqual(null, Token.punctuation(' '));
+    try std.testing.expectEqual(null, Token.punctuation('\t'));
+    try std.testing.expectEqual(null, Token.punctuation('_'));
+}
+
 test "isLiteralDelimiter" {
     try std.testing.expect(Token.isLiteralDelimiter('"'));
     for (std.ascii.lowercase) |character|
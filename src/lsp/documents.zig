@@ -0,0 +1,242 @@
+const std = @import("std");
+const testing = std.testing;
+
+pub const Position = struct {
+    line: u32,
+    character: u32,
+};
+pub const Range = struct {
+    start: Position,
+    end: Position,
+};
+pub const Encoding = enum {
+    utf8,
+    utf16,
+};
+pub const Document = struct {
+    text: std.ArrayList(u8),
+    version: i64,
+    analyzed_version: ?i64,
+    semantic_tokens: []u32,
+    semantic_tokens_result_id: ?u64,
+    semantic_tokens_version: ?i64,
+};
+
+pub const Store = struct {
+    documents: std.StringArrayHashMapUnmanaged(Document),
+
+    pub const empty = Store{ .documents = .empty };
+
+    pub fn deinit(self: *Store, allocator: std.mem.Allocator) void {
+        for (self.documents.keys(), self.documents.values()) |uri, *document| {
+            allocator.free(uri);
+            document.text.deinit(allocator);
+            allocator.free(document.semantic_tokens);
+        }
+        self.documents.deinit(allocator);
+    }
+
+    pub fn open(
+        self: *Store,
+        allocator: std.mem.Allocator,
+        uri: []const u8,
+        version: i64,
+        text: []const u8,
+    ) !void {
+        const entry = try self.documents.getOrPut(allocator, uri);
+        if (entry.found_existing) {
+            entry.value_ptr.text.clearRetainingCapacity();
+        } else {
+            entry.key_ptr.* = allocator.dupe(u8, uri) catch |err| {
+                self.documents.swapRemoveAt(entry.index);
+                return err;
+            };
+            entry.value_ptr.* = .{
+                .text = .empty,
+                .version = version,
+                .analyzed_version = null,
+                .semantic_tokens = &.{},
+                .semantic_tokens_result_id = null,
+                .semantic_tokens_version = null,
+            };
+        }
+        try entry.value_ptr.text.appendSlice(allocator, text);
+        entry.value_ptr.version = version;
+        entry.value_ptr.semantic_tokens_version = null;
+    }
+
+    pub fn change(
+        self: *Store,
+        allocator: std.mem.Allocator,
+        uri: []const u8,
+        version: i64,
+        encoding: Encoding,
+        range: ?Range,
+        text: []const u8,
+    ) !void {
+        const document = self.documents.getPtr(uri) orelse
+            return error.UnknownDocument;
+        if (range) |r| {
+            const start = offset(document.text.items, r.start, encoding);
+            const end = @max(start, offset(document.text.items, r.end, encoding));
+            try document.text.replaceRange(allocator, start, end - start, text);
+        } else {
+            document.text.clearRetainingCapacity();
+            try document.text.appendSlice(allocator, text);
+        }
+        document.version = version;
+    }
+
+    pub fn close(
+        self: *Store,
+        allocator: std.mem.Allocator,
+        uri: []const u8,
+    ) void {
+        const entry = self.documents.fetchSwapRemove(uri) orelse return;
+        allocator.free(entry.key);
+        var document = entry.value;
+        document.text.deinit(allocator);
+        allocator.free(document.semantic_tokens);
+    }
+
+    pub fn get(self: *const Store, uri: []const u8) ?*Document {
+        return self.documents.getPtr(uri);
+    }
+};
+
+fn offset(text: []const u8, position: Position, encoding: Encoding) usize {
+    const start = lineStart(text, position.line) orelse return text.len;
+    const line_end = std.mem.indexOfScalarPos(u8, text, start, '\n') orelse
+        text.len;
+    var index = start;
+    switch (encoding) {
+        .utf8 => {
+            index = @min(start + position.character, line_end);
+            while (index > start and index < line_end and isContinuation(text[index]))
+                index -= 1;
+        },
+        .utf16 => {
+            var count: usize = 0;
+            while (index < line_end and count < position.character) {
+                const len = std.unicode.utf8ByteSequenceLength(text[index]) catch 1;
+                count += if (len == 4) 2 else 1;
+                index = @min(index + len, line_end);
+            }
+        },
+    }
+    return index;
+}
+
+pub fn lineStart(text: []const u8, line: u32) ?usize {
+    var index: usize = 0;
+    for (0..line) |_| {
+        const newline = std.mem.indexOfScalarPos(u8, text, index, '\n') orelse
+            return null;
+        index = newline + 1;
+    }
+    return index;
+}
+
+pub fn units(bytes: []const u8, encoding: Encoding) u32 {
+    if (encoding == .utf8)
+        return @intCast(bytes.len);
+    var len: u32 = 0;
+    for (bytes) |byte| {
+        if (!isContinuation(byte))
+            len += 1;
+        if (byte >= 0xf0)
+            len += 1;
+    }
+    return len;
+}
+
+fn isContinuation(byte: u8) bool {
+    return byte & 0xc0 == 0x80;
+}
+
+test "opens and closes documents" {
+    var store = Store.empty;
+    defer store.deinit(testing.allocator);
+    try store.open(testing.allocator, "file:///a.helena", 1, "link standard/io;");
+    try testing.expectEqualStrings(
+        "link standard/io;",
+        store.get("file:///a.helena").?.text.items,
+    );
+    store.close(testing.allocator, "file:///a.helena");
+    try testing.expectEqual(null, store.get("file:///a.helena"));
+}
+
+test "applies incremental changes" {
+    var store = Store.empty;
+    defer store.deinit(testing.allocator);
+    try store.open(
+        testing.allocator,
+        "file:///a.helena",
+        1,
+        "let main _:@string[] = {\n  print \"Hello\";\n}",
+    );
+    try store.change(
+        testing.allocator,
+        "file:///a.helena",
+        2,
+        .utf16,
+        .{
+            .start = .{ .line = 1, .character = 9 },
+            .end = .{ .line = 1, .character = 14 },
+        },
+        "Helena",
+    );
+    const document = store.get("file:///a.helena").?;
+    try testing.expectEqual(2, document.version);
+    try testing.expectEqualStrings(
+        "let main _:@string[] = {\n  print \"Helena\";\n}",
+        document.text.items,
+    );
+}
+
+test "applies full changes" {
+    var store = Store.empty;
+    defer store.deinit(testing.allocator);
+    try store.open(testing.allocator, "file:///a.helena", 1, "let");
+    try store.change(
+        testing.allocator,
+        "file:///a.helena",
+        2,
+        .utf16,
+        null,
+        "link",
+    );
+    try testing.expectEqualStrings(
+        "link",
+        store.get("file:///a.helena").?.text.items,
+    );
+}
+
+test "clamps positions past the end of a line" {
+    try testing.expectEqual(
+        3,
+        offset("let\nlink", .{ .line = 0, .character = 9 }, .utf16),
+    );
+    try testing.expectEqual(
+        8,
+        offset("let\nlink", .{ .line = 4, .character = 0 }, .utf16),
+    );
+}
+
+test "converts positions between encodings" {
+    const text = "x\n\"é😀\";";
+    try testing.expectEqual(
+        9,
+        offset(text, .{ .line = 1, .character = 4 }, .utf16),
+    );
+    try testing.expectEqual(
+        9,
+        offset(text, .{ .line = 1, .character = 7 }, .utf8),
+    );
+    try testing.expectEqual(
+        3,
+        offset(text, .{ .line = 1, .character = 2 }, .utf8),
+    );
+    try testing.expectEqual(4, units(text[3..10], .utf16));
+    try testing.expectEqual(7, units(text[3..10], .utf8));
+}
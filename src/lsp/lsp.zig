@@ -0,0 +1,757 @@
+const std = @import("std");
+const testing = std.testing;
+const lexer = @import("../lexer/lexer.zig");
+const trace = @import("../trace/trace.zig");
+pub const documents = @import("documents.zig");
+pub const semantic_tokens = @import("semantic_tokens.zig");
+
+const Request = struct {
+    id: ?std.json.Value = null,
+    method: []const u8,
+    params: std.json.Value = .null,
+};
+const InitializeParams = struct {
+    capabilities: struct {
+        general: ?struct {
+            positionEncodings: ?[]const []const u8 = null,
+        } = null,
+    } = .{},
+};
+const TextDocumentItem = struct {
+    uri: []const u8,
+    version: i64,
+    text: []const u8,
+};
+const VersionedTextDocumentIdentifier = struct {
+    uri: []const u8,
+    version: i64,
+};
+const TextDocumentIdentifier = struct {
+    uri: []const u8,
+};
+const ContentChange = struct {
+    range: ?documents.Range = null,
+    text: []const u8,
+};
+const DidOpenParams = struct {
+    textDocument: TextDocumentItem,
+};
+const DidChangeParams = struct {
+    textDocument: VersionedTextDocumentIdentifier,
+    contentChanges: []const ContentChange,
+};
+const DidCloseParams = struct {
+    textDocument: TextDocumentIdentifier,
+};
+const SemanticTokensParams = struct {
+    textDocument: TextDocumentIdentifier,
+};
+const SemanticTokensDeltaParams = struct {
+    textDocument: TextDocumentIdentifier,
+    previousResultId: []const u8,
+};
+const SemanticTokensRangeParams = struct {
+    textDocument: TextDocumentIdentifier,
+    range: documents.Range,
+};
+const Diagnostic = struct {
+    range: documents.Range,
+    severity: u8,
+    source: []const u8,
+    message: []const u8,
+};
+
+const parse_error = -32700;
+const invalid_request = -32600;
+const method_not_found = -32601;
+const invalid_params = -32602;
+const server_not_initialized = -32002;
+const text_document_sync_incremental = 2;
+const severity_error = 1;
+
+pub const Server = struct {
+    allocator: std.mem.Allocator,
+    documents: documents.Store,
+    state: enum { uninitialized, running, shutting_down, exited },
+    encoding: documents.Encoding,
+    next_result_id: u64,
+
+    pub fn init(allocator: std.mem.Allocator) Server {
+        return .{
+            .allocator = allocator,
+            .documents = .empty,
+            .state = .uninitialized,
+            .encoding = .utf16,
+            .next_result_id = 0,
+        };
+    }
+
+    pub fn deinit(self: *Server) void {
+        self.documents.deinit(self.allocator);
+    }
+
+    pub fn serve(
+        self: *Server,
+        reader: *std.Io.Reader,
+        writer: *std.Io.Writer,
+    ) !void {
+        while (self.state != .exited) {
+            const message = readMessage(self.allocator, reader) catch |err|
+                switch (err) {
+                    error.EndOfStream => return,
+                    else => return err,
+                };
+            defer self.allocator.free(message);
+            try self.handle(message, writer);
+            if (reader.bufferedLen() == 0)
+                try self.analyze(writer);
+        }
+    }
+
+    fn handle(
+        self: *Server,
+        message: []const u8,
+        writer: *std.Io.Writer,
+    ) !void {
+        var arena = std.heap.ArenaAllocator.init(self.allocator);
+        defer arena.deinit();
+        const allocator = arena.allocator();
+        const value = std.json.parseFromSliceLeaky(
+            std.json.Value,
+            allocator,
+            message,
+            .{},
+        ) catch return self.sendError(writer, .null, parse_error);
+        const request = std.json.parseFromValueLeaky(
+            Request,
+            allocator,
+            value,
+            .{ .ignore_unknown_fields = true },
+        ) catch return self.sendError(
+            writer,
+            if (value == .object) value.object.get("id") orelse .null else .null,
+            invalid_request,
+        );
+        if (std.mem.eql(u8, request.method, "exit")) {
+            defer self.state = .exited;
+            if (self.state != .shutting_down)
+                return error.ExitWithoutShutdown;
+            return;
+        }
+        if (self.state == .shutting_down) {
+            if (request.id) |id|
+                try self.sendError(writer, id, invalid_request);
+            return;
+        }
+        if (self.state == .uninitialized and
+            !std.mem.eql(u8, request.method, "initialize"))
+        {
+            if (request.id) |id|
+                try self.sendError(writer, id, server_not_initialized);
+            return;
+        }
+        if (std.mem.eql(u8, request.method, "initialize")) {
+            const params = if (request.params == .null)
+                InitializeParams{}
+            else
+                try self.parseParams(InitializeParams, allocator, request, writer) orelse
+                    return;
+            self.state = .running;
+            self.encoding = .utf16;
+            if (params.capabilities.general) |general|
+                for (general.positionEncodings orelse &.{}) |encoding| {
+                    if (std.mem.eql(u8, encoding, "utf-8"))
+                        self.encoding = .utf8;
+                };
+            try self.sendResult(writer, request.id orelse return, .{
+                .capabilities = .{
+                    .positionEncoding = switch (self.encoding) {
+                        .utf8 => "utf-8",
+                        .utf16 => "utf-16",
+                    },
+                    .textDocumentSync = .{
+                        .openClose = true,
+                        .change = text_document_sync_incremental,
+                    },
+                    .semanticTokensProvider = .{
+                        .legend = .{
+                            .tokenTypes = semantic_tokens.legend,
+                            .tokenModifiers = &[_][]const u8{},
+                        },
+                        .range = true,
+                        .full = .{ .delta = true },
+                    },
+                },
+                .serverInfo = .{ .name = "helena" },
+            });
+        } else if (std.mem.eql(u8, request.method, "shutdown")) {
+            self.state = .shutting_down;
+            try self.sendResult(
+                writer,
+                request.id orelse return,
+                @as(?u8, null),
+            );
+        } else if (std.mem.eql(u8, request.method, "textDocument/didOpen")) {
+            const params = try self.parseParams(
+                DidOpenParams,
+                allocator,
+                request,
+                writer,
+            ) orelse return;
+            try self.documents.open(
+                self.allocator,
+                params.textDocument.uri,
+                params.textDocument.version,
+                params.textDocument.text,
+            );
+        } else if (std.mem.eql(u8, request.method, "textDocument/didChange")) {
+            const params = try self.parseParams(
+                DidChangeParams,
+                allocator,
+                request,
+                writer,
+            ) orelse return;
+            for (params.contentChanges) |change|
+                self.documents.change(
+                    self.allocator,
+                    params.textDocument.uri,
+                    params.textDocument.version,
+                    self.encoding,
+                    change.range,
+                    change.text,
+                ) catch |err| switch (err) {
+                    error.UnknownDocument => return,
+                    else => return err,
+                };
+        } else if (std.mem.eql(u8, request.method, "textDocument/didClose")) {
+            const params = try self.parseParams(
+                DidCloseParams,
+                allocator,
+                request,
+                writer,
+            ) orelse return;
+            self.documents.close(self.allocator, params.textDocument.uri);
+        } else if (std.mem.eql(
+            u8,
+            request.method,
+            "textDocument/semanticTokens/full",
+        )) {
+            const params = try self.parseParams(
+                SemanticTokensParams,
+                allocator,
+                request,
+                writer,
+            ) orelse return;
+            const id = request.id orelse return;
+            const document = self.documents.get(params.textDocument.uri) orelse
+                return self.sendResult(writer, id, @as(?u8, null));
+            const result_id = try self.encodeSemanticTokens(document);
+            try self.sendResult(writer, id, .{
+                .resultId = try std.fmt.allocPrint(allocator, "{d}", .{result_id}),
+                .data = document.semantic_tokens,
+            });
+        } else if (std.mem.eql(
+            u8,
+            request.method,
+            "textDocument/semanticTokens/full/delta",
+        )) {
+            const params = try self.parseParams(
+                SemanticTokensDeltaParams,
+                allocator,
+                request,
+                writer,
+            ) orelse return;
+            const id = request.id orelse return;
+            const document = self.documents.get(params.textDocument.uri) orelse
+                return self.sendResult(writer, id, @as(?u8, null));
+            const previous_result_id = std.fmt.parseInt(
+                u64,
+                params.previousResultId,
+                10,
+            ) catch null;
+            const previous = if (previous_result_id != null and
+                document.semantic_tokens_result_id != null and
+                previous_result_id.? == document.semantic_tokens_result_id.?)
+                try allocator.dupe(u32, document.semantic_tokens)
+            else
+                null;
+            const result_id = try self.encodeSemanticTokens(document);
+            const result_id_text = try std.fmt.allocPrint(
+                allocator,
+                "{d}",
+                .{result_id},
+            );
+            if (previous) |p| {
+                const edits: []const semantic_tokens.Edit =
+                    if (semantic_tokens.diff(p, document.semantic_tokens)) |edit|
+                        try allocator.dupe(semantic_tokens.Edit, &.{edit})
+                    else
+                        &.{};
+                try self.sendResult(writer, id, .{
+                    .resultId = result_id_text,
+                    .edits = edits,
+                });
+            } else {
+                try self.sendResult(writer, id, .{
+                    .resultId = result_id_text,
+                    .data = document.semantic_tokens,
+                });
+            }
+        } else if (std.mem.eql(
+            u8,
+            request.method,
+            "textDocument/semanticTokens/range",
+        )) {
+            const params = try self.parseParams(
+                SemanticTokensRangeParams,
+                allocator,
+                request,
+                writer,
+            ) orelse return;
+            const id = request.id orelse return;
+            const document = self.documents.get(params.textDocument.uri) orelse
+                return self.sendResult(writer, id, @as(?u8, null));
+            if (document.semantic_tokens_version == document.version)
+                return self.sendResult(writer, id, .{
+                    .data = try semantic_tokens.slice(
+                        allocator,
+                        document.semantic_tokens,
+                        params.range,
+                    ),
+                });
+            const result = try lexer.tokenize(
+                self.allocator,
+                document.text.items,
+            );
+            defer result.destroy(self.allocator);
+            const data = try semantic_tokens.encode(
+                self.allocator,
+                document.text.items,
+                result.locations,
+                params.range,
+                self.encoding,
+            );
+            defer self.allocator.free(data);
+            try self.sendResult(writer, id, .{ .data = data });
+        } else if (request.id) |id| {
+            try self.sendError(writer, id, method_not_found);
+        }
+    }
+
+    fn encodeSemanticTokens(
+        self: *Server,
+        document: *documents.Document,
+    ) !u64 {
+        const result = try lexer.tokenize(self.allocator, document.text.items);
+        defer result.destroy(self.allocator);
+        const data = try semantic_tokens.encode(
+            self.allocator,
+            document.text.items,
+            result.locations,
+            null,
+            self.encoding,
+        );
+        self.allocator.free(document.semantic_tokens);
+        document.semantic_tokens = data;
+        document.semantic_tokens_result_id = self.next_result_id;
+        document.semantic_tokens_version = document.version;
+        self.next_result_id += 1;
+        return document.semantic_tokens_result_id.?;
+    }
+
+    fn analyze(self: *Server, writer: *std.Io.Writer) !void {
+        var iterator = self.documents.documents.iterator();
+        while (iterator.next()) |entry| {
+            const document = entry.value_ptr;
+            if (document.analyzed_version) |version|
+                if (version == document.version)
+                    continue;
+            document.analyzed_version = document.version;
+            try self.publishDiagnostics(
+                writer,
+                entry.key_ptr.*,
+                document,
+            );
+        }
+    }
+
+    fn publishDiagnostics(
+        self: *Server,
+        writer: *std.Io.Writer,
+        uri: []const u8,
+        document: *const documents.Document,
+    ) !void {
+        const span = trace.beginDetail("publish diagnostics", uri);
+        defer span.end();
+        const result = try lexer.tokenize(self.allocator, document.text.items);
+        defer result.destroy(self.allocator);
+        const diagnostics = try self.allocator.alloc(
+            Diagnostic,
+            result.diagnostics.len,
+        );
+        defer self.allocator.free(diagnostics);
+        const text = document.text.items;
+        for (result.diagnostics, diagnostics) |diagnostic, *converted|
+            converted.* = switch (diagnostic) {
+                .unterminated_literal => |location| .{
+                    .range = range: {
+                        const line = text[documents.lineStart(text, location.row).?..];
+                        const character = documents.units(
+                            line[0..location.column],
+                            self.encoding,
+                        );
+                        break :range .{
+                            .start = .{
+                                .line = location.row,
+                                .character = character,
+                            },
+                            .end = .{
+                                .line = location.row,
+                                .character = character + 1,
+                            },
+                        };
+                    },
+                    .severity = severity_error,
+                    .source = "helena",
+                    .message = "unterminated literal",
+                },
+            };
+        try self.send(writer, .{
+            .jsonrpc = "2.0",
+            .method = "textDocument/publishDiagnostics",
+            .params = .{
+                .uri = uri,
+                .version = document.version,
+                .diagnostics = diagnostics,
+            },
+        });
+    }
+
+    fn sendResult(
+        self: *Server,
+        writer: *std.Io.Writer,
+        id: std.json.Value,
+        result: anytype,
+    ) !void {
+        try self.send(writer, .{ .jsonrpc = "2.0", .id = id, .result = result });
+    }
+
+    fn sendError(
+        self: *Server,
+        writer: *std.Io.Writer,
+        id: std.json.Value,
+        code: i32,
+    ) !void {
+        try self.send(writer, .{
+            .jsonrpc = "2.0",
+            .id = id,
+            .@"error" = .{
+                .code = code,
+                .message = switch (code) {
+                    parse_error => "parse error",
+                    invalid_request => "invalid request",
+                    method_not_found => "method not found",
+                    invalid_params => "invalid params",
+                    server_not_initialized => "server not initialized",
+                    else => "error",
+                },
+            },
+        });
+    }
+
+    fn parseParams(
+        self: *Server,
+        comptime T: type,
+        allocator: std.mem.Allocator,
+        request: Request,
+        writer: *std.Io.Writer,
+    ) !?T {
+        return std.json.parseFromValueLeaky(
+            T,
+            allocator,
+            request.params,
+            .{ .ignore_unknown_fields = true },
+        ) catch {
+            if (request.id) |id|
+                try self.sendError(writer, id, invalid_params);
+            return null;
+        };
+    }
+
+    fn send(self: *Server, writer: *std.Io.Writer, message: anytype) !void {
+        var body = std.Io.Writer.Allocating.init(self.allocator);
+        defer body.deinit();
+        try std.json.Stringify.value(message, .{}, &body.writer);
+        try writer.print(
+            "Content-Length: {d}\r\n\r\n{s}",
+            .{ body.written().len, body.written() },
+        );
+        try writer.flush();
+    }
+};
+
+fn readMessage(allocator: std.mem.Allocator, reader: *std.Io.Reader) ![]u8 {
+    const content_length_header = "content-length:";
+    var content_length: ?usize = null;
+    while (true) {
+        const line = std.mem.trimEnd(
+            u8,
+            try reader.takeDelimiterInclusive('\n'),
+            "\r\n",
+        );
+        if (line.len == 0)
+            break;
+        if (std.ascii.startsWithIgnoreCase(line, content_length_header))
+            content_length = try std.fmt.parseInt(
+                usize,
+                std.mem.trim(u8, line[content_length_header.len..], " "),
+                10,
+            );
+    }
+    return reader.readAlloc(
+        allocator,
+        content_length orelse return error.MissingContentLength,
+    );
+}
+
+fn frame(allocator: std.mem.Allocator, messages: []const []const u8) ![]u8 {
+    var framed = std.Io.Writer.Allocating.init(allocator);
+    errdefer framed.deinit();
+    for (messages) |message|
+        try framed.writer.print(
+            "Content-Length: {d}\r\n\r\n{s}",
+            .{ message.len, message },
+        );
+    return framed.toOwnedSlice();
+}
+
+const initialize_response =
+    \\{"jsonrpc":"2.0","id":1,"result":{"capabilities":{"positionEncoding":"utf-16","textDocumentSync":{"openClose":true,"change":2},"semanticTokensProvider":{"legend":{"tokenTypes":["keyword","type","string","number"],"tokenModifiers":[]},"range":true,"full":{"delta":true}}},"serverInfo":{"name":"helena"}}}
+;
+
+fn expectResponses(
+    messages: []const []const u8,
+    expected: []const []const u8,
+) !void {
+    const input = try frame(testing.allocator, messages);
+    defer testing.allocator.free(input);
+    var reader = std.Io.Reader.fixed(input);
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    var server = Server.init(testing.allocator);
+    defer server.deinit();
+    try server.serve(&reader, &output.writer);
+    const framed = try frame(testing.allocator, expected);
+    defer testing.allocator.free(framed);
+    try testing.expectEqualStrings(framed, output.written());
+}
+
+test {
+    _ = documents;
+    _ = semantic_tokens;
+}
+
+test "initializes and shuts down" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","id":2,"method":"shutdown"}
+            ,
+            \\{"jsonrpc":"2.0","method":"exit"}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","id":2,"result":null}
+        },
+    );
+}
+
+test "rejects requests before initialization" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"shutdown"}
+        },
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"error":{"code":-32002,"message":"server not initialized"}}
+        },
+    );
+}
+
+test "rejects requests after shutdown" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","id":2,"method":"shutdown"}
+            ,
+            \\{"jsonrpc":"2.0","id":3,"method":"textDocument/semanticTokens/full","params":{"textDocument":{"uri":"file:///a.helena"}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"exit"}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","id":2,"result":null}
+            ,
+            \\{"jsonrpc":"2.0","id":3,"error":{"code":-32600,"message":"invalid request"}}
+        },
+    );
+}
+
+test "fails when exiting without shutdown" {
+    const input = try frame(testing.allocator, &.{
+        \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+        ,
+        \\{"jsonrpc":"2.0","method":"exit"}
+    });
+    defer testing.allocator.free(input);
+    var reader = std.Io.Reader.fixed(input);
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    var server = Server.init(testing.allocator);
+    defer server.deinit();
+    try testing.expectError(
+        error.ExitWithoutShutdown,
+        server.serve(&reader, &output.writer),
+    );
+}
+
+test "answers malformed messages and params" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","id":2,
+            ,
+            \\{"jsonrpc":"2.0","id":3}
+            ,
+            \\{"jsonrpc":"2.0","id":4,"method":"textDocument/semanticTokens/full","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{}}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","id":null,"error":{"code":-32700,"message":"parse error"}}
+            ,
+            \\{"jsonrpc":"2.0","id":3,"error":{"code":-32600,"message":"invalid request"}}
+            ,
+            \\{"jsonrpc":"2.0","id":4,"error":{"code":-32602,"message":"invalid params"}}
+        },
+    );
+}
+
+test "publishes lexer diagnostics for the latest version only" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///a.helena","languageId":"helena","version":1,"text":"print \"Hello\";"}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///a.helena","version":2},"contentChanges":[{"range":{"start":{"line":0,"character":12},"end":{"line":0,"character":13}},"text":""}]}}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///a.helena","version":2,"diagnostics":[{"range":{"start":{"line":0,"character":6},"end":{"line":0,"character":7}},"severity":1,"source":"helena","message":"unterminated literal"}]}}
+        },
+    );
+}
+
+test "counts positions in UTF-16 code units by default" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///a.helena","languageId":"helena","version":1,"text":"print \"é\"; print \"😀\";"}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///a.helena","version":2},"contentChanges":[{"range":{"start":{"line":0,"character":20},"end":{"line":0,"character":21}},"text":""}]}}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///a.helena","version":2,"diagnostics":[{"range":{"start":{"line":0,"character":17},"end":{"line":0,"character":18}},"severity":1,"source":"helena","message":"unterminated literal"}]}}
+        },
+    );
+}
+
+test "negotiates UTF-8 positions" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{"capabilities":{"general":{"positionEncodings":["utf-16","utf-8"]}}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///a.helena","languageId":"helena","version":1,"text":"print \"é\"; print \"😀\";"}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///a.helena","version":2},"contentChanges":[{"range":{"start":{"line":0,"character":23},"end":{"line":0,"character":24}},"text":""}]}}
+        },
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"result":{"capabilities":{"positionEncoding":"utf-8","textDocumentSync":{"openClose":true,"change":2},"semanticTokensProvider":{"legend":{"tokenTypes":["keyword","type","string","number"],"tokenModifiers":[]},"range":true,"full":{"delta":true}}},"serverInfo":{"name":"helena"}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///a.helena","version":2,"diagnostics":[{"range":{"start":{"line":0,"character":18},"end":{"line":0,"character":19}},"severity":1,"source":"helena","message":"unterminated literal"}]}}
+        },
+    );
+}
+
+test "serves full, delta and range semantic tokens" {
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///a.helena","languageId":"helena","version":1,"text":"let n 7"}}}
+            ,
+            \\{"jsonrpc":"2.0","id":2,"method":"textDocument/semanticTokens/full","params":{"textDocument":{"uri":"file:///a.helena"}}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///a.helena","version":2},"contentChanges":[{"text":"let n 7\nlink"}]}}
+            ,
+            \\{"jsonrpc":"2.0","id":3,"method":"textDocument/semanticTokens/full/delta","params":{"textDocument":{"uri":"file:///a.helena"},"previousResultId":"0"}}
+            ,
+            \\{"jsonrpc":"2.0","id":4,"method":"textDocument/semanticTokens/range","params":{"textDocument":{"uri":"file:///a.helena"},"range":{"start":{"line":1,"character":0},"end":{"line":1,"character":4}}}}
+            ,
+            \\{"jsonrpc":"2.0","id":5,"method":"textDocument/semanticTokens/range","params":{"textDocument":{"uri":"file:///a.helena"},"range":{"start":{"line":0,"character":4},"end":{"line":1,"character":0}}}}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","id":2,"result":{"resultId":"0","data":[0,0,3,0,0,0,6,1,3,0]}}
+            ,
+            \\{"jsonrpc":"2.0","id":3,"result":{"resultId":"1","edits":[{"start":10,"deleteCount":0,"data":[1,0,4,0,0]}]}}
+            ,
+            \\{"jsonrpc":"2.0","id":4,"result":{"data":[1,0,4,0,0]}}
+            ,
+            \\{"jsonrpc":"2.0","id":5,"result":{"data":[0,6,1,3,0]}}
+            ,
+            \\{"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///a.helena","version":2,"diagnostics":[]}}
+        },
+    );
+}
+
+test "analyzes large documents" {
+    const line = "  let message = \"Hello, world!\";\n";
+    const line_count = 50_000;
+    const text = try testing.allocator.alloc(u8, line.len * line_count);
+    defer testing.allocator.free(text);
+    for (0..line_count) |index|
+        @memcpy(text[index * line.len ..][0..line.len], line);
+    var open = std.Io.Writer.Allocating.init(testing.allocator);
+    defer open.deinit();
+    try std.json.Stringify.value(.{
+        .jsonrpc = "2.0",
+        .method = "textDocument/didOpen",
+        .params = .{
+            .textDocument = .{
+                .uri = "file:///a.helena",
+                .languageId = "helena",
+                .version = 1,
+                .text = text,
+            },
+        },
+    }, .{}, &open.writer);
+    try expectResponses(
+        &.{
+            \\{"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+            ,
+            open.written(),
+            \\{"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///a.helena","version":2},"contentChanges":[{"range":{"start":{"line":49999,"character":30},"end":{"line":49999,"character":31}},"text":""}]}}
+        },
+        &.{
+            initialize_response,
+            \\{"jsonrpc":"2.0","method":"textDocument/publishDiagnostics","params":{"uri":"file:///a.helena","version":2,"diagnostics":[{"range":{"start":{"line":49999,"character":16},"end":{"line":49999,"character":17}},"severity":1,"source":"helena","message":"unterminated literal"}]}}
+        },
+    );
+}
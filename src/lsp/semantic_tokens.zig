@@ -0,0 +1,358 @@
+const std = @import("std");
+const testing = std.testing;
+const lexer = @import("../lexer/lexer.zig");
+const documents = @import("documents.zig");
+
+pub const Type = enum(u32) {
+    keyword,
+    type,
+    string,
+    number,
+};
+pub const Edit = struct {
+    start: u32,
+    deleteCount: u32,
+    data: []const u32,
+};
+
+pub const legend = std.meta.fieldNames(Type);
+
+const Encoder = struct {
+    data: std.ArrayList(u32),
+    previous: documents.Position,
+    range: ?documents.Range,
+    text: []const u8,
+    encoding: documents.Encoding,
+    line: struct {
+        row: u32,
+        start: usize,
+        column: u32,
+        character: u32,
+    },
+
+    fn append(
+        self: *Encoder,
+        allocator: std.mem.Allocator,
+        row: u32,
+        column: u32,
+        length: usize,
+        kind: Type,
+    ) !void {
+        if (self.range) |range|
+            if (row < range.start.line or row > range.end.line)
+                return;
+        const start = self.character(row, column);
+        const end = self.character(row, column + @as(u32, @intCast(length)));
+        if (self.range) |range|
+            if (!overlaps(range, .{ .line = row, .character = start }, end - start))
+                return;
+        if (row < self.previous.line or
+            (row == self.previous.line and start < self.previous.character))
+            return;
+        const delta_line = row - self.previous.line;
+        try self.data.appendSlice(allocator, &.{
+            delta_line,
+            if (delta_line == 0) start - self.previous.character else start,
+            end - start,
+            @intFromEnum(kind),
+            0,
+        });
+        self.previous = .{ .line = row, .character = start };
+    }
+
+    fn character(self: *Encoder, row: u32, column: u32) u32 {
+        if (self.encoding == .utf8)
+            return column;
+        while (self.line.row < row) : (self.line.row += 1) {
+            const newline = std.mem.indexOfScalarPos(
+                u8,
+                self.text,
+                self.line.start,
+                '\n',
+            ) orelse self.text.len;
+            self.line.start = @min(newline + 1, self.text.len);
+            self.line.column = 0;
+            self.line.character = 0;
+        }
+        const line = self.text[self.line.start..];
+        const byte = @min(column, line.len);
+        if (byte < self.line.column) {
+            self.line.column = 0;
+            self.line.character = 0;
+        }
+        self.line.character += documents.units(
+            line[self.line.column..byte],
+            self.encoding,
+        );
+        self.line.column = @intCast(byte);
+        return self.line.character;
+    }
+
+    fn appendLiteral(
+        self: *Encoder,
+        allocator: std.mem.Allocator,
+        location: lexer.Location,
+        text: []const u8,
+    ) !void {
+        var lines = std.mem.splitScalar(u8, text, '\n');
+        var row = location.row;
+        var column = location.column;
+        var length_of_delimiters: usize = 1;
+        while (lines.next()) |line| : ({
+            row += 1;
+            column = 0;
+            length_of_delimiters = 0;
+        }) {
+            if (lines.peek() == null)
+                length_of_delimiters += 1;
+            try self.append(
+                allocator,
+                row,
+                column,
+                line.len + length_of_delimiters,
+                .string,
+            );
+        }
+    }
+};
+
+pub fn encode(
+    allocator: std.mem.Allocator,
+    text: []const u8,
+    locations: []const lexer.Location,
+    range: ?documents.Range,
+    encoding: documents.Encoding,
+) ![]u32 {
+    var encoder = Encoder{
+        .data = .empty,
+        .previous = .{ .line = 0, .character = 0 },
+        .range = range,
+        .text = text,
+        .encoding = encoding,
+        .line = .{ .row = 0, .start = 0, .column = 0, .character = 0 },
+    };
+    errdefer encoder.data.deinit(allocator);
+    var index: usize = 0;
+    while (index < locations.len) : (index += 1) {
+        const location = locations[index];
+        const kind: Type, const length: usize = switch (location.token) {
+            .let => .{ .keyword, "let".len },
+            .link => .{ .keyword, "link".len },
+            .number => |number| .{ .number, number.text.len },
+            .at => if (index + 1 < locations.len and
+                locations[index + 1].token == .identifier)
+            _: {
+                index += 1;
+                break :_ .{ .type, 1 + locations[index].token.identifier.len };
+            } else continue,
+            .literal => |text| {
+                try encoder.appendLiteral(allocator, location, text);
+                continue;
+            },
+            else => continue,
+        };
+        try encoder.append(
+            allocator,
+            location.row,
+            location.column,
+            length,
+            kind,
+        );
+    }
+    return encoder.data.toOwnedSlice(allocator);
+}
+
+pub fn slice(
+    allocator: std.mem.Allocator,
+    data: []const u32,
+    range: documents.Range,
+) ![]u32 {
+    var result = std.ArrayList(u32).empty;
+    errdefer result.deinit(allocator);
+    var position = documents.Position{ .line = 0, .character = 0 };
+    var previous = position;
+    var index: usize = 0;
+    while (index + 5 <= data.len) : (index += 5) {
+        const token = data[index..][0..5];
+        position = if (token[0] == 0)
+            .{ .line = position.line, .character = position.character + token[1] }
+        else
+            .{ .line = position.line + token[0], .character = token[1] };
+        if (position.line > range.end.line)
+            break;
+        if (!overlaps(range, position, token[2]))
+            continue;
+        const delta_line = position.line - previous.line;
+        try result.appendSlice(allocator, &.{
+            delta_line,
+            if (delta_line == 0)
+                position.character - previous.character
+            else
+                position.character,
+            token[2],
+            token[3],
+            token[4],
+        });
+        previous = position;
+    }
+    return result.toOwnedSlice(allocator);
+}
+
+fn overlaps(range: documents.Range, start: documents.Position, length: u32) bool {
+    return !(start.line < range.start.line or
+        (start.line == range.start.line and
+            start.character + length <= range.start.character) or
+        start.line > range.end.line or
+        (start.line == range.end.line and start.character >= range.end.character));
+}
+
+pub fn diff(previous: []const u32, current: []const u32) ?Edit {
+    const shortest = @min(previous.len, current.len);
+    var prefix: usize = 0;
+    while (prefix < shortest and previous[prefix] == current[prefix])
+        prefix += 1;
+    if (prefix == previous.len and prefix == current.len)
+        return null;
+    var suffix: usize = 0;
+    while (suffix < shortest - prefix and
+        previous[previous.len - 1 - suffix] == current[current.len - 1 - suffix])
+        suffix += 1;
+    return .{
+        .start = @intCast(prefix),
+        .deleteCount = @intCast(previous.len - prefix - suffix),
+        .data = current[prefix .. current.len - suffix],
+    };
+}
+
+fn expectEncoding(
+    src: []const u8,
+    range: ?documents.Range,
+    encoding: documents.Encoding,
+    expected: []const u32,
+) !void {
+    const result = try lexer.tokenize(testing.allocator, src);
+    defer result.destroy(testing.allocator);
+    const data = try encode(
+        testing.allocator,
+        src,
+        result.locations,
+        range,
+        encoding,
+    );
+    defer testing.allocator.free(data);
+    try testing.expectEqualSlices(u32, expected, data);
+}
+
+test "encodes keywords, types, literals and numbers" {
+    try expectEncoding(
+        \\link standard/io
+        \\let n @uint 7
+        \\print "Hello"
+    ,
+        null,
+        .utf16,
+        &.{
+            0, 0, 4, 0, 0,
+            1, 0, 3, 0, 0,
+            0, 6, 5, 1, 0,
+            0, 6, 1, 3, 0,
+            1, 6, 7, 2, 0,
+        },
+    );
+}
+
+test "encodes multi-line literals one line at a time" {
+    try expectEncoding(
+        "print \"Hello,\nworld!\"",
+        null,
+        .utf16,
+        &.{
+            0, 6, 7, 2, 0,
+            1, 0, 7, 2, 0,
+        },
+    );
+}
+
+test "encodes ranges" {
+    try expectEncoding(
+        \\link standard/io
+        \\let n 7
+        \\let m 8
+    ,
+        .{
+            .start = .{ .line = 1, .character = 0 },
+            .end = .{ .line = 1, .character = 7 },
+        },
+        .utf16,
+        &.{
+            1, 0, 3, 0, 0,
+            0, 6, 1, 3, 0,
+        },
+    );
+}
+
+test "encodes tokens overlapping an exclusive range" {
+    try expectEncoding(
+        \\link standard/io
+        \\let n 7
+        \\let m 8
+    ,
+        .{
+            .start = .{ .line = 1, .character = 4 },
+            .end = .{ .line = 2, .character = 0 },
+        },
+        .utf16,
+        &.{ 1, 6, 1, 3, 0 },
+    );
+}
+
+test "slices encoded tokens by range" {
+    const src = "link standard/io\nlet n @uint 7\nprint \"a\nb\" 8";
+    const result = try lexer.tokenize(testing.allocator, src);
+    defer result.destroy(testing.allocator);
+    const data = try encode(testing.allocator, src, result.locations, null, .utf16);
+    defer testing.allocator.free(data);
+    const ranges = [_]documents.Range{
+        .{ .start = .{ .line = 0, .character = 0 }, .end = .{ .line = 3, .character = 9 } },
+        .{ .start = .{ .line = 1, .character = 5 }, .end = .{ .line = 1, .character = 12 } },
+        .{ .start = .{ .line = 1, .character = 12 }, .end = .{ .line = 3, .character = 0 } },
+        .{ .start = .{ .line = 2, .character = 7 }, .end = .{ .line = 3, .character = 3 } },
+    };
+    for (ranges) |range| {
+        const expected = try encode(
+            testing.allocator,
+            src,
+            result.locations,
+            range,
+            .utf16,
+        );
+        defer testing.allocator.free(expected);
+        const sliced = try slice(testing.allocator, data, range);
+        defer testing.allocator.free(sliced);
+        try testing.expectEqualSlices(u32, expected, sliced);
+    }
+}
+
+test "encodes columns and lengths in the negotiated units" {
+    const src = "print \"é😀\" @uint";
+    try expectEncoding(src, null, .utf16, &.{
+        0, 6, 5, 2, 0,
+        0, 6, 5, 1, 0,
+    });
+    try expectEncoding(src, null, .utf8, &.{
+        0, 6, 8, 2, 0,
+        0, 9, 5, 1, 0,
+    });
+}
+
+test "diffs encodings" {
+    try testing.expectEqual(null, diff(&.{ 1, 2, 3 }, &.{ 1, 2, 3 }));
+    const edit = diff(&.{ 1, 2, 3, 4 }, &.{ 1, 5, 6, 4 }).?;
+    try testing.expectEqual(1, edit.start);
+    try testing.expectEqual(2, edit.deleteCount);
+    try testing.expectEqualSlices(u32, &.{ 5, 6 }, edit.data);
+    const insertion = diff(&.{ 1, 1 }, &.{ 1, 1, 1 }).?;
+    try testing.expectEqual(2, insertion.start);
+    try testing.expectEqual(0, insertion.deleteCount);
+    try testing.expectEqualSlices(u32, &.{1}, insertion.data);
+}
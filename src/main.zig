@@ -1,10 +1,221 @@
 const std = @import("std");
-const lexer = @import("helena").lexer;
+const helena = @import("helena");
+const index = helena.index;
+const lsp = helena.lsp;
+const trace = helena.trace;
+const memory = helena.memory;
 
-pub fn main() !void {
+const usage =
+    \\Usage: helena [options] <command>
+    \\
+    \\Options:
+    \\  --trace=<file>             Write Chrome trace events to a file
+    \\  --mem-stats                Report memory usage per phase and file
+    \\
+    \\Commands:
+    \\  lsp                        Serve the Language Server Protocol over stdio
+    \\  symbols [root]             Update the symbol index of a workspace
+    \\  definition <name> [root]   List the declarations of a symbol
+    \\  references <name> [root]   List the references to a symbol
+    \\  index [root]               Update the trigram index of a workspace
+    \\  search <text> [root]       Search source text outside literals
+    \\    --literals               Also match text inside a single literal
+    \\
+;
+
+pub fn main(init: std.process.Init.Minimal) !void {
     var allocator_wrapper = std.heap.DebugAllocator(.{}){};
-    const allocator = allocator_wrapper.allocator();
     defer _ = allocator_wrapper.deinit();
-    _ = try lexer.tokenize(allocator, "");
-    std.debug.print("Hello, world!\n", .{});
+    var counting = memory.CountingAllocator.init(allocator_wrapper.allocator());
+    defer counting.deinit();
+    var arguments = try init.args.iterateAllocator(allocator_wrapper.allocator());
+    defer arguments.deinit();
+    _ = arguments.skip();
+    const trace_option = "--trace=";
+    var trace_path: ?[]const u8 = null;
+    var is_mem_stats = false;
+    var command = arguments.next();
+    while (command) |option| : (command = arguments.next()) {
+        if (std.mem.startsWith(u8, option, trace_option))
+            trace_path = option[trace_option.len..]
+        else if (std.mem.eql(u8, option, "--mem-stats"))
+            is_mem_stats = true
+        else
+            break;
+    }
+    if (trace_path != null and !trace.enabled)
+        std.debug.print(
+            "Tracing is disabled in this build; rebuild with -Dtrace to use --trace.\n",
+            .{},
+        );
+    const allocator = if (is_mem_stats)
+        counting.allocator()
+    else
+        allocator_wrapper.allocator();
+    if (is_mem_stats)
+        memory.trackFiles(&counting);
+    defer memory.trackFiles(null);
+    var threaded = std.Io.Threaded.init(allocator, .{});
+    defer threaded.deinit();
+    const io = threaded.io();
+    const result = run(allocator, io, command orelse {
+        std.debug.print(usage, .{});
+        return;
+    }, &arguments);
+    if (trace.enabled) {
+        defer trace.deinit();
+        if (trace_path) |path|
+            try writeTrace(io, path);
+    }
+    if (is_mem_stats)
+        try writeMemoryStats(io, &counting);
+    return result;
+}
+
+fn run(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    command: []const u8,
+    arguments: anytype,
+) !void {
+    if (std.mem.eql(u8, command, "lsp")) {
+        try serveLsp(allocator, io);
+    } else if (std.mem.eql(u8, command, "symbols")) {
+        try updateIndex(allocator, io, arguments.next(), index.updateSymbols);
+    } else if (std.mem.eql(u8, command, "definition") or
+        std.mem.eql(u8, command, "references"))
+    {
+        const name = arguments.next() orelse {
+            std.debug.print("Missing symbol name.\n\n" ++ usage, .{});
+            return error.MissingArgument;
+        };
+        try findSymbol(
+            io,
+            if (std.mem.eql(u8, command, "definition"))
+                .declaration
+            else
+                .reference,
+            name,
+            arguments.next(),
+        );
+    } else if (std.mem.eql(u8, command, "index")) {
+        try updateIndex(allocator, io, arguments.next(), index.updateTrigrams);
+    } else if (std.mem.eql(u8, command, "search")) {
+        var query: ?[]const u8 = null;
+        var root_path: ?[]const u8 = null;
+        var include_literals = false;
+        while (arguments.next()) |argument| {
+            if (std.mem.eql(u8, argument, "--literals"))
+                include_literals = true
+            else if (query == null)
+                query = argument
+            else
+                root_path = argument;
+        }
+        try search(
+            allocator,
+            io,
+            query orelse {
+                std.debug.print("Missing search text.\n\n" ++ usage, .{});
+                return error.MissingArgument;
+            },
+            root_path,
+            include_literals,
+        );
+    } else {
+        std.debug.print("Unknown command \"{s}\".\n\n" ++ usage, .{command});
+        return error.UnknownCommand;
+    }
+}
+
+fn writeTrace(io: std.Io, path: []const u8) !void {
+    const file = try std.Io.Dir.cwd().createFile(io, path, .{});
+    defer file.close(io);
+    var buffer: [64 * 1024]u8 = undefined;
+    var writer = file.writer(io, &buffer);
+    try trace.write(&writer.interface);
+    try writer.interface.flush();
+}
+
+fn writeMemoryStats(io: std.Io, counting: *memory.CountingAllocator) !void {
+    var buffer: [64 * 1024]u8 = undefined;
+    var writer = std.Io.File.stderr().writer(io, &buffer);
+    try counting.report(&writer.interface);
+    try writer.interface.flush();
+}
+
+fn serveLsp(allocator: std.mem.Allocator, io: std.Io) !void {
+    var input_buffer: [64 * 1024]u8 = undefined;
+    var output_buffer: [64 * 1024]u8 = undefined;
+    var input = std.Io.File.stdin().reader(io, &input_buffer);
+    var output = std.Io.File.stdout().writer(io, &output_buffer);
+    var server = lsp.Server.init(allocator);
+    defer server.deinit();
+    try server.serve(&input.interface, &output.interface);
+}
+
+fn openRoot(io: std.Io, root: ?[]const u8) !std.Io.Dir {
+    return std.Io.Dir.cwd().openDir(io, root orelse ".", .{ .iterate = true });
+}
+
+fn updateIndex(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    root_path: ?[]const u8,
+    comptime updateFn: anytype,
+) !void {
+    const root = try openRoot(io, root_path);
+    defer root.close(io);
+    const update = try updateFn(allocator, io, root);
+    std.debug.print(
+        "Indexed {d} files ({d} lexed).\n",
+        .{ update.file_count, update.lexed_count },
+    );
+}
+
+fn findSymbol(
+    io: std.Io,
+    kind: index.symbols.Kind,
+    name: []const u8,
+    root_path: ?[]const u8,
+) !void {
+    const root = try openRoot(io, root_path);
+    defer root.close(io);
+    const mapping = try index.Mapping.open(io, root, index.symbols_file_name);
+    defer mapping.close();
+    mapping.advise(.random);
+    const view = try index.symbols.View.init(mapping.bytes);
+    var buffer: [64 * 1024]u8 = undefined;
+    var output = std.Io.File.stdout().writer(io, &buffer);
+    const writer = &output.interface;
+    if (try view.lookup(name)) |symbol|
+        for (try view.find(kind, symbol)) |record|
+            try writer.print("{s}:{d}:{d}\n", .{
+                try view.path(record.file),
+                record.row + 1,
+                record.column + 1,
+            });
+    try writer.flush();
+}
+
+fn search(
+    allocator: std.mem.Allocator,
+    io: std.Io,
+    query: []const u8,
+    root_path: ?[]const u8,
+    include_literals: bool,
+) !void {
+    const root = try openRoot(io, root_path);
+    defer root.close(io);
+    var buffer: [64 * 1024]u8 = undefined;
+    var output = std.Io.File.stdout().writer(io, &buffer);
+    try index.search(
+        allocator,
+        io,
+        root,
+        query,
+        include_literals,
+        &output.interface,
+    );
+    try output.interface.flush();
 }
@@ -0,0 +1,347 @@
+const std = @import("std");
+const testing = std.testing;
+
+pub const Phase = enum {
+    driver,
+    lexing,
+    indexing,
+};
+pub const Stats = struct {
+    allocated: usize,
+    allocations: usize,
+    peak: usize,
+};
+
+const Counters = struct {
+    allocated: std.atomic.Value(usize) = .init(0),
+    allocations: std.atomic.Value(usize) = .init(0),
+    peak: std.atomic.Value(usize) = .init(0),
+    live: std.atomic.Value(usize) = .init(0),
+
+    fn load(self: *const Counters) Stats {
+        return .{
+            .allocated = self.allocated.load(.monotonic),
+            .allocations = self.allocations.load(.monotonic),
+            .peak = self.peak.load(.monotonic),
+        };
+    }
+};
+
+threadlocal var current_phase: Phase = .driver;
+threadlocal var thread_allocated: usize = 0;
+threadlocal var thread_allocations: usize = 0;
+
+pub const PhaseScope = struct {
+    previous: Phase,
+
+    pub fn exit(self: PhaseScope) void {
+        current_phase = self.previous;
+    }
+};
+
+pub fn enter(phase: Phase) PhaseScope {
+    defer current_phase = phase;
+    return .{ .previous = current_phase };
+}
+
+pub const FileScope = struct {
+    counting: ?*CountingAllocator,
+    path: []const u8,
+    allocated: usize,
+    allocations: usize,
+
+    pub fn exit(self: FileScope) void {
+        const counting = self.counting orelse return;
+        counting.recordFile(
+            self.path,
+            thread_allocated - self.allocated,
+            thread_allocations - self.allocations,
+        ) catch {};
+    }
+};
+
+pub const CountingAllocator = struct {
+    child: std.mem.Allocator,
+    phases: [std.meta.fields(Phase).len]Counters,
+    live: std.atomic.Value(usize),
+    peak: std.atomic.Value(usize),
+    files: std.StringArrayHashMapUnmanaged(Stats),
+    files_mutex: std.Thread.Mutex,
+
+    pub fn init(child: std.mem.Allocator) CountingAllocator {
+        return .{
+            .child = child,
+            .phases = @splat(.{}),
+            .live = .init(0),
+            .peak = .init(0),
+            .files = .empty,
+            .files_mutex = .{},
+        };
+    }
+
+    pub fn deinit(self: *CountingAllocator) void {
+        for (self.files.keys()) |path|
+            self.child.free(path);
+        self.files.deinit(self.child);
+    }
+
+    pub fn allocator(self: *CountingAllocator) std.mem.Allocator {
+        return .{
+            .ptr = self,
+            .vtable = &.{
+                .alloc = alloc,
+                .resize = resize,
+                .remap = remap,
+                .free = free,
+            },
+        };
+    }
+
+    pub fn enterFile(self: *CountingAllocator, path: []const u8) FileScope {
+        return .{
+            .counting = self,
+            .path = path,
+            .allocated = thread_allocated,
+            .allocations = thread_allocations,
+        };
+    }
+
+    pub fn stats(self: *const CountingAllocator, phase: Phase) Stats {
+        return self.phases[@intFromEnum(phase)].load();
+    }
+
+    pub fn report(self: *CountingAllocator, writer: *std.Io.Writer) !void {
+        try writer.print(
+            "{s:<12}{s:>16}{s:>14}{s:>16}\n",
+            .{ "phase", "allocated", "allocations", "peak live" },
+        );
+        for (std.enums.values(Phase)) |phase| {
+            const s = self.stats(phase);
+            try writer.print(
+                "{s:<12}{d:>16}{d:>14}{d:>16}\n",
+                .{ @tagName(phase), s.allocated, s.allocations, s.peak },
+            );
+        }
+        try writer.print(
+            "{s:<12}{s:>16}{s:>14}{d:>16}\n",
+            .{ "total", "", "", self.peak.load(.monotonic) },
+        );
+        self.files_mutex.lock();
+        defer self.files_mutex.unlock();
+        if (self.files.count() == 0)
+            return;
+        self.files.sort(struct {
+            values: []const Stats,
+
+            pub fn lessThan(context: @This(), lhs: usize, rhs: usize) bool {
+                return context.values[lhs].allocated > context.values[rhs].allocated;
+            }
+        }{ .values = self.files.values() });
+        try writer.print(
+            "\n{s:<40}{s:>16}{s:>14}\n",
+            .{ "file", "allocated", "allocations" },
+        );
+        for (self.files.keys(), self.files.values()) |path, s|
+            try writer.print(
+                "{s:<40}{d:>16}{d:>14}\n",
+                .{ path, s.allocated, s.allocations },
+            );
+    }
+
+    fn recordFile(
+        self: *CountingAllocator,
+        path: []const u8,
+        allocated: usize,
+        allocations: usize,
+    ) !void {
+        self.files_mutex.lock();
+        defer self.files_mutex.unlock();
+        const entry = try self.files.getOrPut(self.child, path);
+        if (!entry.found_existing) {
+            entry.key_ptr.* = self.child.dupe(u8, path) catch |err| {
+                self.files.swapRemoveAt(entry.index);
+                return err;
+            };
+            entry.value_ptr.* = .{ .allocated = 0, .allocations = 0, .peak = 0 };
+        }
+        entry.value_ptr.allocated += allocated;
+        entry.value_ptr.allocations += allocations;
+    }
+
+    fn grow(
+        self: *CountingAllocator,
+        phase: Phase,
+        len: usize,
+        allocations: usize,
+    ) void {
+        const counters = &self.phases[@intFromEnum(phase)];
+        _ = counters.allocated.fetchAdd(len, .monotonic);
+        _ = counters.allocations.fetchAdd(allocations, .monotonic);
+        const phase_live = counters.live.fetchAdd(len, .monotonic) + len;
+        _ = counters.peak.fetchMax(phase_live, .monotonic);
+        const live = self.live.fetchAdd(len, .monotonic) + len;
+        _ = self.peak.fetchMax(live, .monotonic);
+        thread_allocated += len;
+        thread_allocations += allocations;
+    }
+
+    fn shrink(self: *CountingAllocator, phase: Phase, len: usize) void {
+        _ = self.phases[@intFromEnum(phase)].live.fetchSub(len, .monotonic);
+        _ = self.live.fetchSub(len, .monotonic);
+    }
+
+    // Every block carries one trailing byte naming the phase that allocated
+    // it, so frees and resizes are charged back to that phase.
+    fn phaseOf(memory: []const u8) Phase {
+        return @enumFromInt(memory.ptr[memory.len]);
+    }
+
+    fn tag(memory: [*]u8, len: usize, phase: Phase) void {
+        memory[len] = @intFromEnum(phase);
+    }
+
+    fn alloc(
+        context: *anyopaque,
+        len: usize,
+        alignment: std.mem.Alignment,
+        return_address: usize,
+    ) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(context));
+        const memory = self.child.rawAlloc(len + 1, alignment, return_address) orelse
+            return null;
+        tag(memory, len, current_phase);
+        self.grow(current_phase, len, 1);
+        return memory;
+    }
+
+    fn resize(
+        context: *anyopaque,
+        memory: []u8,
+        alignment: std.mem.Alignment,
+        new_len: usize,
+        return_address: usize,
+    ) bool {
+        const self: *CountingAllocator = @ptrCast(@alignCast(context));
+        const phase = phaseOf(memory);
+        if (!self.child.rawResize(
+            memory.ptr[0 .. memory.len + 1],
+            alignment,
+            new_len + 1,
+            return_address,
+        ))
+            return false;
+        tag(memory.ptr, new_len, phase);
+        self.resized(phase, memory.len, new_len);
+        return true;
+    }
+
+    fn remap(
+        context: *anyopaque,
+        memory: []u8,
+        alignment: std.mem.Alignment,
+        new_len: usize,
+        return_address: usize,
+    ) ?[*]u8 {
+        const self: *CountingAllocator = @ptrCast(@alignCast(context));
+        const phase = phaseOf(memory);
+        const remapped = self.child.rawRemap(
+            memory.ptr[0 .. memory.len + 1],
+            alignment,
+            new_len + 1,
+            return_address,
+        ) orelse return null;
+        tag(remapped, new_len, phase);
+        self.resized(phase, memory.len, new_len);
+        return remapped;
+    }
+
+    fn free(
+        context: *anyopaque,
+        memory: []u8,
+        alignment: std.mem.Alignment,
+        return_address: usize,
+    ) void {
+        const self: *CountingAllocator = @ptrCast(@alignCast(context));
+        const phase = phaseOf(memory);
+        self.child.rawFree(memory.ptr[0 .. memory.len + 1], alignment, return_address);
+        self.shrink(phase, memory.len);
+    }
+
+    fn resized(
+        self: *CountingAllocator,
+        phase: Phase,
+        old_len: usize,
+        new_len: usize,
+    ) void {
+        if (new_len > old_len)
+            self.grow(phase, new_len - old_len, 0)
+        else
+            self.shrink(phase, old_len - new_len);
+    }
+};
+
+var file_counting: ?*CountingAllocator = null;
+
+pub fn trackFiles(counting: ?*CountingAllocator) void {
+    file_counting = counting;
+}
+
+pub fn enterFile(path: []const u8) FileScope {
+    return if (file_counting) |counting|
+        counting.enterFile(path)
+    else
+        .{ .counting = null, .path = path, .allocated = 0, .allocations = 0 };
+}
+
+test "attributes allocations to the active phase" {
+    var counting = CountingAllocator.init(testing.allocator);
+    defer counting.deinit();
+    const allocator = counting.allocator();
+    const driver = try allocator.alloc(u8, 16);
+    defer allocator.free(driver);
+    const kept = kept: {
+        const phase = enter(.lexing);
+        defer phase.exit();
+        const lexing = try allocator.alloc(u8, 64);
+        allocator.free(lexing);
+        const more = try allocator.alloc(u8, 32);
+        allocator.free(more);
+        break :kept try allocator.alloc(u8, 8);
+    };
+    try testing.expectEqual(Phase.driver, current_phase);
+    allocator.free(try allocator.alloc(u8, 16));
+    allocator.free(kept);
+    try testing.expectEqual(
+        Stats{ .allocated = 32, .allocations = 2, .peak = 32 },
+        counting.stats(.driver),
+    );
+    try testing.expectEqual(
+        Stats{ .allocated = 104, .allocations = 3, .peak = 64 },
+        counting.stats(.lexing),
+    );
+    try testing.expectEqual(
+        Stats{ .allocated = 0, .allocations = 0, .peak = 0 },
+        counting.stats(.indexing),
+    );
+}
+
+test "attributes allocations to files" {
+    var counting = CountingAllocator.init(testing.allocator);
+    defer counting.deinit();
+    const allocator = counting.allocator();
+    trackFiles(&counting);
+    defer trackFiles(null);
+    for (0..2) |_| {
+        const file = enterFile("a.helena");
+        defer file.exit();
+        allocator.free(try allocator.alloc(u8, 8));
+    }
+    try testing.expectEqual(
+        Stats{ .allocated = 16, .allocations = 2, .peak = 0 },
+        counting.files.get("a.helena").?,
+    );
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    try counting.report(&output.writer);
+    try testing.expect(std.mem.indexOf(u8, output.written(), "a.helena") != null);
+}
@@ -1 +1,13 @@
 pub const lexer = @import("lexer/lexer.zig");
+pub const lsp = @import("lsp/lsp.zig");
+pub const index = @import("index/index.zig");
+pub const trace = @import("trace/trace.zig");
+pub const memory = @import("memory/memory.zig");
+
+test {
+    _ = lexer;
+    _ = lsp;
+    _ = index;
+    _ = trace;
+    _ = memory;
+}
@@ -0,0 +1,217 @@
+const std = @import("std");
+const testing = std.testing;
+const build_options = @import("build_options");
+
+pub const enabled = build_options.trace;
+
+const capacity = 1 << 14;
+const detail_capacity = 64;
+
+const Event = struct {
+    name: []const u8,
+    phase: enum { begin, end },
+    timestamp: u64,
+    detail: [detail_capacity]u8,
+    detail_len: u8,
+};
+
+const Buffer = struct {
+    events: [capacity]Event,
+    head: usize,
+    thread: std.Thread.Id,
+    next: ?*Buffer,
+};
+
+var buffers = std.atomic.Value(?*Buffer).init(null);
+threadlocal var local_buffer: ?*Buffer = null;
+
+pub const Span = struct {
+    name: if (enabled) []const u8 else void,
+
+    pub inline fn end(self: Span) void {
+        if (enabled)
+            record(self.name, .end, "");
+    }
+};
+
+pub inline fn begin(comptime name: []const u8) Span {
+    return beginDetail(name, "");
+}
+
+pub inline fn beginDetail(comptime name: []const u8, detail: []const u8) Span {
+    if (!enabled)
+        return .{ .name = {} };
+    record(name, .begin, detail);
+    return .{ .name = name };
+}
+
+fn record(
+    name: []const u8,
+    phase: @FieldType(Event, "phase"),
+    detail: []const u8,
+) void {
+    const buffer = local_buffer orelse register() orelse return;
+    const event = &buffer.events[buffer.head % capacity];
+    const detail_len = @min(detail.len, detail_capacity);
+    event.name = name;
+    event.phase = phase;
+    event.timestamp = now();
+    @memcpy(event.detail[0..detail_len], detail[0..detail_len]);
+    event.detail_len = @intCast(detail_len);
+    buffer.head += 1;
+}
+
+fn register() ?*Buffer {
+    const buffer = std.heap.page_allocator.create(Buffer) catch return null;
+    buffer.head = 0;
+    buffer.thread = std.Thread.getCurrentId();
+    buffer.next = buffers.load(.acquire);
+    while (buffers.cmpxchgWeak(
+        buffer.next,
+        buffer,
+        .release,
+        .acquire,
+    )) |head|
+        buffer.next = head;
+    local_buffer = buffer;
+    return buffer;
+}
+
+fn now() u64 {
+    const time = std.posix.clock_gettime(.MONOTONIC) catch return 0;
+    return @as(u64, @intCast(time.sec)) * std.time.ns_per_s +
+        @as(u64, @intCast(time.nsec));
+}
+
+pub fn write(writer: *std.Io.Writer) !void {
+    try writer.writeAll("{\"traceEvents\":[");
+    var is_first = true;
+    var buffer = buffers.load(.acquire);
+    while (buffer) |b| : (buffer = b.next) {
+        var depth: usize = 0;
+        const start = b.head -| capacity;
+        for (start..b.head) |index| {
+            const event = &b.events[index % capacity];
+            if (event.phase == .begin) {
+                depth += 1;
+            } else if (depth == 0) {
+                continue;
+            } else {
+                depth -= 1;
+            }
+            if (!is_first)
+                try writer.writeByte(',');
+            is_first = false;
+            try writeEvent(writer, event, b.thread);
+        }
+    }
+    try writer.writeAll("]}\n");
+}
+
+fn writeEvent(
+    writer: *std.Io.Writer,
+    event: *const Event,
+    thread: std.Thread.Id,
+) !void {
+    try writer.writeAll("{\"name\":");
+    try std.json.Stringify.value(event.name, .{}, writer);
+    try writer.print(
+        ",\"ph\":\"{s}\",\"ts\":{d}.{d:0>3},\"pid\":1,\"tid\":{d}",
+        .{
+            switch (event.phase) {
+                .begin => "B",
+                .end => "E",
+            },
+            event.timestamp / std.time.ns_per_us,
+            event.timestamp % std.time.ns_per_us,
+            thread,
+        },
+    );
+    if (event.detail_len > 0) {
+        try writer.writeAll(",\"args\":{\"detail\":");
+        try std.json.Stringify.value(
+            event.detail[0..event.detail_len],
+            .{},
+            writer,
+        );
+        try writer.writeByte('}');
+    }
+    try writer.writeByte('}');
+}
+
+pub fn deinit() void {
+    var buffer = buffers.swap(null, .acq_rel);
+    while (buffer) |b| {
+        buffer = b.next;
+        std.heap.page_allocator.destroy(b);
+    }
+    local_buffer = null;
+}
+
+test "records begin and end events per thread" {
+    if (!enabled)
+        return error.SkipZigTest;
+    deinit();
+    defer deinit();
+    {
+        const span = beginDetail("lex", "a.helena");
+        defer span.end();
+    }
+    const thread = try std.Thread.spawn(.{}, struct {
+        fn run() void {
+            const span = begin("analyze");
+            span.end();
+        }
+    }.run, .{});
+    thread.join();
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    try write(&output.writer);
+    const json = output.written();
+    try testing.expectEqual(4, std.mem.count(u8, json, "\"ph\""));
+    try testing.expect(std.mem.indexOf(
+        u8,
+        json,
+        "\"name\":\"lex\",\"ph\":\"B\"",
+    ) != null);
+    try testing.expect(std.mem.indexOf(
+        u8,
+        json,
+        "\"args\":{\"detail\":\"a.helena\"}",
+    ) != null);
+    try testing.expect(std.mem.indexOf(u8, json, "\"name\":\"analyze\"") != null);
+}
+
+test "drops end events whose begin was overwritten" {
+    if (!enabled)
+        return error.SkipZigTest;
+    deinit();
+    defer deinit();
+    {
+        const outer = begin("outer");
+        defer outer.end();
+        for (0..capacity / 2) |_| {
+            const span = begin("inner");
+            span.end();
+        }
+    }
+    var output = std.Io.Writer.Allocating.init(testing.allocator);
+    defer output.deinit();
+    try write(&output.writer);
+    const json = output.written();
+    try testing.expectEqual(
+        capacity / 2 - 1,
+        std.mem.count(u8, json, "\"ph\":\"B\""),
+    );
+    try testing.expectEqual(
+        capacity / 2 - 1,
+        std.mem.count(u8, json, "\"ph\":\"E\""),
+    );
+    try testing.expectEqual(null, std.mem.indexOf(u8, json, "\"outer\""));
+}
+
+test "compiles spans out when disabled" {
+    if (enabled)
+        return error.SkipZigTest;
+    try testing.expectEqual(0, @sizeOf(Span));
+}